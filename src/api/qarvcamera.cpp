@@ -29,16 +29,95 @@ extern "C" {
 #include "qarvfeaturetree.h"
 #include "qarvtype.h"
 #include "globals.h"
+#include "spscring.h"
+#include "bufferpool.h"
 #include <QTextDocument>
+#include <QSet>
+#include <atomic>
 
 using namespace QArv;
 
+namespace
+{
+
+/*
+ * The buffers lent to the stream for one acquisition run. Frames may outlive
+ * the run, so a buffer released after acquisition has stopped goes back to
+ * the pool instead of the stream. The session holds the pool's reference to
+ * each of its buffers.
+ */
+struct StreamSession {
+    QMutex lock;
+    // Null once acquisition has stopped.
+    ArvStream* stream = nullptr;
+    QList<ArvBuffer*> buffers;
+    // Buffers currently held by frames.
+    QSet<ArvBuffer*> held;
+    QSharedPointer<BufferPool> pool;
+
+    // Called when the last reference to a frame is dropped.
+    void release(ArvBuffer* buffer) {
+        QMutexLocker l(&lock);
+        held.remove(buffer);
+        if (stream) {
+            arv_stream_push_buffer(stream, buffer);
+        } else {
+            // Drop the reference popped off the stream.
+            g_object_unref(buffer);
+            pool->recycle(buffer);
+        }
+    }
+};
+
+}
+
 class QArvCamera::QArvCameraExtension {
     friend class QArvCamera;
+    friend void QArvStreamCallback(void*, int, ArvBuffer*);
 
 private:
+    // Completed buffers, pushed by the stream thread, popped by takeFrame().
+    SpscRing<ArvBuffer*> ring;
+    // Set by the stream thread when it emits framesQueued(), cleared by the
+    // consumer when it finds the ring empty.
+    std::atomic<bool> wakeupPending { false };
+    bool ringDelivery = false;
+    QSharedPointer<BufferPool> pool { new BufferPool };
+    QSharedPointer<StreamSession> session;
+    // Zero when the queue has a fixed size.
+    uint budgetMB = 0;
+    size_t payloadSize = 0;
+    uint maxBuffers = 0;
+
+    void growQueue();
 };
 
+// Upper bound on the queue length when sizing by memory budget, which keeps
+// the ring reasonably small even for tiny payloads.
+static const uint maxBudgetedBuffers = 4096;
+
+/*
+ * Adds half as many buffers again as the stream currently has, within the
+ * memory budget. Called from the consumer thread after an underrun.
+ */
+void QArvCamera::QArvCameraExtension::growQueue() {
+    if (budgetMB == 0 || !session)
+        return;
+    const uint current = session->buffers.size();
+    const uint target = qMin(maxBuffers, current + qMax(1u, current / 2));
+    if (target <= current)
+        return;
+    auto added = pool->take(payloadSize, target - current);
+    QMutexLocker l(&session->lock);
+    session->buffers << added;
+    foreach (auto buffer, added) {
+        g_object_ref(buffer);
+        arv_stream_push_buffer(session->stream, buffer);
+    }
+    logMessage() << "Frame queue grown to" << session->buffers.size()
+                 << "buffers.";
+}
+
 QList<QArvCameraId> QArvCamera::cameraList;
 
 void QArvCamera::init() {
@@ -47,6 +126,8 @@ void QArvCamera::init() {
 #endif
     arv_enable_interface("Fake");
     qRegisterMetaType<ArvBuffer*>("ArvBuffer*");
+    qRegisterMetaType<QArvFrameMeta>("QArvFrameMeta");
+    qRegisterMetaType<QArvFramePtr>("QArvFramePtr");
 }
 
 QArvCameraId::QArvCameraId() : id(NULL), vendor(NULL), model(NULL) {}
@@ -91,9 +172,9 @@ QArvCamera::QArvCamera(QArvCameraId id, QObject* parent) :
 }
 
 QArvCamera::~QArvCamera() {
+    stopAcquisition();
     delete ext;
     QArvFeatureTree::freeFeaturetree(featuretree);
-    stopAcquisition();
     g_object_unref(camera);
 }
 
@@ -429,12 +510,7 @@ void QArvCamera::setAutoGain(bool enable) {
     emit dataChanged(QModelIndex(), QModelIndex());
 }
 
-//! Store the pointer to the current frame.
-void QArvCamera::receiveFrame() {
-    if (!acquiring)
-        return; // Stream does not exist any more.
-
-    ArvBuffer* frame = arv_stream_pop_buffer(stream);
+QByteArray QArvCamera::frameData(ArvBuffer* frame) {
     QByteArray baframe;
     ArvBufferStatus status;
 #ifdef ARAVIS_OLD_BUFFER
@@ -458,24 +534,101 @@ void QArvCamera::receiveFrame() {
             baframe = QByteArray(static_cast<const char*>(data), size);
         }
     }
+    return baframe;
+}
 
-    emit frameReady(baframe, frame);
-    arv_stream_push_buffer(stream, frame);
+QArvFrameMeta QArvCamera::frameMeta(ArvBuffer* frame) {
+    QArvFrameMeta meta;
+#ifdef ARAVIS_OLD_BUFFER
+    meta.frameId = frame->frame_id;
+    meta.timestamp = frame->timestamp_ns;
+    meta.status = frame->status;
+    meta.payloadSize = frame->size;
+    meta.roi = QRect(frame->x_offset, frame->y_offset,
+                     frame->width, frame->height);
+#else
+    meta.frameId = arv_buffer_get_frame_id(frame);
+    meta.timestamp = arv_buffer_get_timestamp(frame);
+    meta.status = arv_buffer_get_status(frame);
+    size_t size;
+    arv_buffer_get_data(frame, &size);
+    meta.payloadSize = size;
+    int x, y, width, height;
+    arv_buffer_get_image_region(frame, &x, &y, &width, &height);
+    meta.roi = QRect(x, y, width, height);
+#endif
+#ifdef ARAVIS_HAVE_08_API
+    meta.systemTimestamp = arv_buffer_get_system_timestamp(frame);
+#else
+    meta.systemTimestamp = g_get_real_time() * 1000;
+#endif
+    return meta;
+}
+
+/*
+ * When the data is copied, the buffer is returned to the stream right away.
+ * Otherwise, the frame holds a reference to the stream session so that the
+ * buffer can be returned from any thread, even after acquisition has been
+ * stopped.
+ */
+QArvFramePtr QArvCamera::wrapFrame(ArvBuffer* frame) {
+    auto data = frameData(frame);
+    auto meta = frameMeta(frame);
+    if (!nocopy) {
+        arv_stream_push_buffer(stream, frame);
+        return QArvFramePtr(new QArvFrame(data, meta));
+    }
+    auto session = ext->session;
+    {
+        QMutexLocker l(&session->lock);
+        session->held.insert(frame);
+    }
+    auto release = [session](ArvBuffer* buffer) {
+        session->release(buffer);
+    };
+    return QArvFramePtr(new QArvFrame(data, meta, frame, release));
+}
 
+void QArvCamera::checkUnderruns() {
     guint64 under;
     arv_stream_get_statistics(stream, NULL, NULL, &under);
     if (under != underruns) {
         underruns = under;
-        int in, out;
-        arv_stream_get_n_buffers(stream, &in, &out);
+        ext->growQueue();
         emit bufferUnderrun();
     }
 }
 
+//! Store the pointer to the current frame.
+void QArvCamera::receiveFrame() {
+    if (!acquiring)
+        return; // Stream does not exist any more.
+
+    ArvBuffer* frame = arv_stream_pop_buffer(stream);
+    auto wrapped = wrapFrame(frame);
+
+    emit frameReady(wrapped);
+    emit frameReady(wrapped->data(), wrapped->meta());
+    // The buffer is returned to the stream once the last receiver lets go.
+    wrapped.clear();
+
+    checkUnderruns();
+}
+
 inline void QArvStreamCallback(void* vcam, int type, ArvBuffer* bfr) {
     if (type == ARV_STREAM_CALLBACK_TYPE_BUFFER_DONE) {
         auto cam = static_cast<QArvCamera*>(vcam);
-        QMetaObject::invokeMethod(cam, "receiveFrame", Qt::QueuedConnection);
+        auto ext = cam->ext;
+        if (ext->ringDelivery) {
+            // Cannot fail, the ring holds at least as many slots as there
+            // are buffers on the stream.
+            ext->ring.push(bfr);
+            if (!ext->wakeupPending.exchange(true))
+                emit cam->framesQueued();
+        } else {
+            QMetaObject::invokeMethod(cam, "receiveFrame",
+                                      Qt::QueuedConnection);
+        }
     }
 }
 
@@ -490,14 +643,13 @@ static void QArvStreamCallbackWrap(void* vcam,
  * frames onto the stream and sets up the callback which accepts frames.
  * \param dropInvalidFrames If true, the frameReady() signal will return
  * an empty QByteArray when the frame is not complete.
- * \param zeroCopy If true, the QByteArray sent by the
- * frameReady() signal doesn't own the data. The
- * caller guarantees that the frame will be used "quickly", i.e. before it is
- * used to capture the next image. Only use this if the caller will decode or
- * otherwise copy the data immediately. Note that the array itself is never
- * invalidated after the grace period passes, it is merely overwritten.
- * Also note that zeroCopy only applies to the QBytearray; the ArvBuffer is
- * never copied.
+ * \param zeroCopy If true, the frame data is not copied out of the Aravis
+ * buffer. This is safe when using QArvFramePtr, because the buffer is not
+ * reused until the frame is released. The QByteArray sent by
+ * frameReady(QByteArray, QArvFrameMeta), however, doesn't own the data,
+ * and the caller must use it "quickly", i.e. before the buffer is used to
+ * capture another image, unless it also holds on to the QArvFramePtr.
+ * When copying, the buffer is returned to the stream immediately.
  */
 void QArvCamera::startAcquisition(bool zeroCopy, bool dropInvalidFrames) {
     nocopy = zeroCopy;
@@ -510,9 +662,26 @@ void QArvCamera::startAcquisition(bool zeroCopy, bool dropInvalidFrames) {
     unsigned int framesize = arv_camera_get_payload(camera);
     stream = arv_camera_create_stream(camera, QArvStreamCallbackWrap, this);
 #endif
-    for (uint i = 0; i < frameQueueSize; i++) {
-        arv_stream_push_buffer(stream, arv_buffer_new(framesize, NULL));
+    uint count = frameQueueSize;
+    ext->payloadSize = framesize;
+    ext->maxBuffers = frameQueueSize;
+    if (ext->budgetMB > 0 && framesize > 0) {
+        quint64 fit = (quint64(ext->budgetMB) << 20) / framesize;
+        ext->maxBuffers = qBound<quint64>(1, fit, maxBudgetedBuffers);
+        count = qMin(count, ext->maxBuffers);
+    }
+    // The ring must have room for every buffer the stream may ever have.
+    ext->ring.reset(ext->maxBuffers);
+    ext->wakeupPending.store(false);
+    auto session = QSharedPointer<StreamSession>::create();
+    session->stream = stream;
+    session->pool = ext->pool;
+    session->buffers = ext->pool->take(framesize, count);
+    foreach (auto buffer, session->buffers) {
+        g_object_ref(buffer);
+        arv_stream_push_buffer(stream, buffer);
     }
+    ext->session = session;
 #ifdef ARAVIS_HAVE_08_API
     arv_camera_start_acquisition(camera, nullptr);
 #else
@@ -530,7 +699,24 @@ void QArvCamera::stopAcquisition() {
 #else
     arv_camera_stop_acquisition(camera);
 #endif
+    auto session = ext->session;
+    ext->session.clear();
+    QList<ArvBuffer*> idle;
+    {
+        QMutexLocker l(&session->lock);
+        session->stream = nullptr;
+        foreach (auto buffer, session->buffers) {
+            if (!session->held.contains(buffer))
+                idle << buffer;
+        }
+    }
+    // This joins the stream thread and drops the references to the buffers
+    // still queued on the stream. Buffers held by frames return to the pool
+    // when the frames are released.
     g_object_unref(stream);
+    foreach (auto buffer, idle) {
+        ext->pool->recycle(buffer);
+    }
     acquiring = false;
     emit dataChanged(QModelIndex(), QModelIndex());
 }
@@ -538,17 +724,104 @@ void QArvCamera::stopAcquisition() {
 //! Set the number of frames on the stream. Takes effect on startAcquisition().
 /*! An Aravis stream has a queue of frame buffers which is cycled as frames are
  * acquired. The frameReady() signal returns the frame that is currently being
- * cycled. Several frames should be put on the queue for smooth operation. More
- * should be used when using the zeroCopy facility of startAcquisition(), as this
- * increases the grace period in which the returned frame is valid. For
- * example, with the queue size of 30 and framerate of 60 FPS, the grace period
- * is approximately one half second. Increasing the queue size increases the
- * memory usage, as all buffers are allocated when acquisition starts.
+ * cycled. Several frames should be put on the queue for smooth operation.
+ * Frames that are held by the program (see QArvFrame) are not available to
+ * the camera, so more buffers are needed if frames are kept for a while.
+ * Increasing the queue size increases the memory usage, as all buffers are
+ * allocated when acquisition starts. Buffers are kept in a pool when
+ * acquisition stops and reused on restart if the payload size is unchanged,
+ * so that a restart does not need to allocate and touch the memory again.
  */
 void QArvCamera::setFrameQueueSize(uint size) {
     frameQueueSize = size;
 }
 
+//! Size the frame queue by memory use. Takes effect on startAcquisition().
+/*! With a nonzero budget, the number of buffers is limited to what fits in
+ * the given number of megabytes at the current payload size, and the size
+ * given by setFrameQueueSize() is only the initial queue length. Whenever the
+ * stream reports new underruns, the queue is grown by half, up to the budget,
+ * while acquisition continues. The queue is not shrunk until acquisition is
+ * restarted. A budget of zero keeps the queue at a fixed size.
+ */
+void QArvCamera::setFrameQueueBudget(uint megabytes) {
+    ext->budgetMB = megabytes;
+}
+
+//! Set how frame buffers are allocated. Takes effect on startAcquisition().
+/*! Buffers are always mapped and prefaulted up front, so that the first frames
+ * do not incur page faults.
+ * \param lockPages Lock the buffers into RAM so that they cannot be swapped
+ * out. This may fail due to RLIMIT_MEMLOCK, in which case a message is logged
+ * and the buffers are used unlocked.
+ * \param hugePages Back the buffers with huge pages, reducing TLB pressure
+ * for large frames. Explicit huge pages are tried first, falling back to
+ * transparent huge pages.
+ *
+ * Only buffers allocated afterwards are affected; call releaseIdleBuffers()
+ * to make sure none are reused.
+ */
+void QArvCamera::setFrameBufferOptions(bool lockPages, bool hugePages) {
+    ext->pool->setOptions(lockPages, hugePages);
+}
+
+//! Free the buffers kept in the pool while acquisition is stopped.
+void QArvCamera::releaseIdleBuffers() {
+    ext->pool->clear();
+}
+
+//! Choose between frameReady() and the lock-free ring. Takes effect on startAcquisition().
+/*! By default, every completed buffer is announced to the camera's thread
+ * with a queued call, which then emits frameReady(). At high frame rates,
+ * the per-frame event is a significant source of latency and jitter. When
+ * ring delivery is enabled, the Aravis stream thread instead puts the buffer
+ * on a single-producer/single-consumer ring and emits framesQueued() only
+ * if the consumer is idle. The consumer then calls takeFrame() in a loop
+ * until it returns a null pointer. frameReady() is not emitted in this mode.
+ *
+ * The consumer must be a single thread, normally the one the camera lives in.
+ */
+void QArvCamera::setFrameRingDelivery(bool enable) {
+    if (acquiring) {
+        logMessage() << "Frame delivery mode cannot be changed while acquiring.";
+        return;
+    }
+    ext->ringDelivery = enable;
+}
+
+bool QArvCamera::frameRingDelivery() {
+    return ext->ringDelivery;
+}
+
+/*!
+ * Takes the oldest completed frame off the ring. Returns a null pointer if
+ * there is none, in which case framesQueued() will be emitted once another
+ * frame arrives. The buffer is returned to the stream when the last
+ * reference to the frame is released.
+ */
+QArvFramePtr QArvCamera::takeFrame() {
+    if (!acquiring || !ext->ringDelivery)
+        return QArvFramePtr();
+
+    ArvBuffer* buffer;
+    if (!ext->ring.pop(buffer)) {
+        // About to go idle. Clear the flag before looking again so that a
+        // frame pushed in between is either seen now or triggers a wakeup.
+        ext->wakeupPending.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ext->ring.pop(buffer))
+            return QArvFramePtr();
+    }
+
+    // The stream thread moves the buffer to the Aravis output queue right
+    // after the callback returns. Keep that queue in step with the ring.
+    ArvBuffer* frame = arv_stream_pop_buffer(stream);
+    Q_ASSERT(frame == buffer);
+    auto wrapped = wrapFrame(frame);
+    checkUnderruns();
+    return wrapped;
+}
+
 //! Translates betwen the glib and Qt address types via a native sockaddr.
 static QHostAddress GSocketAddress_to_QHostAddress(GSocketAddress* gaddr) {
     sockaddr addr;
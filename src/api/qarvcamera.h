@@ -29,6 +29,7 @@
 #include <QImage>
 #include <QHostAddress>
 #include <QAbstractItemModel>
+#include "qarvframe.h"
 
 #pragma GCC visibility push(default)
 
@@ -186,6 +187,20 @@ public:
     void startAcquisition(bool zeroCopy = true, bool dropInvalidFrames = true);
     void stopAcquisition();
     void setFrameQueueSize(uint size = 30);
+    void setFrameQueueBudget(uint megabytes = 0);
+    void setFrameBufferOptions(bool lockPages = false, bool hugePages = false);
+    void releaseIdleBuffers();
+    /**@}*/
+
+    /*! \name Lock-free frame delivery
+     * Instead of emitting frameReady() for every frame, the camera can hand
+     * completed buffers directly from the Aravis stream thread to a single
+     * consumer thread via a bounded lock-free ring. See setFrameRingDelivery().
+     */
+    /**@{*/
+    void setFrameRingDelivery(bool enable);
+    bool frameRingDelivery();
+    QArvFramePtr takeFrame();
     /**@}*/
 
     /*! \name Manipulate network parameters of an ethernet camera
@@ -204,17 +219,38 @@ public:
 signals:
     //! Emitted when a new frame is ready.
     /*! \param frame The raw frame data. May be empty for invalid frames.
-     *  \param aravisFrame The raw Aravis frame. This allows access to info
-     *  such as timestamp.
+     *  \param meta Information such as the frame ID and timestamp, captured
+     *  when the frame was received.
      *  \sa ::startAcquisition()
      */
-    void frameReady(QByteArray frame, ArvBuffer* aravisFrame);
+    void frameReady(QByteArray frame, QArvFrameMeta meta);
+    //! Emitted when a new frame is ready.
+    /*! This is emitted together with the signal above. The frame keeps its
+     * buffer away from the stream until all references to it are released,
+     * so it is safe to use the data even when it was not copied.
+     */
+    void frameReady(QArvFramePtr frame);
+    //! Emitted when frames are waiting to be taken with takeFrame().
+    /*! This signal is emitted from the Aravis stream thread, but only when
+     * the consumer has emptied the ring, not once per frame. Connect to it
+     * with a queued connection.
+     */
+    void framesQueued();
     //! Emitted when a buffer underrun occurs.
+    /*! If a memory budget is set, the queue has already been grown, as far
+     * as the budget allows, by the time this is emitted.
+     */
     void bufferUnderrun();
 
 private slots:
     void receiveFrame();
 
+private:
+    QByteArray frameData(ArvBuffer* frame);
+    QArvFrameMeta frameMeta(ArvBuffer* frame);
+    QArvFramePtr wrapFrame(ArvBuffer* frame);
+    void checkUnderruns();
+
 private:
     QArvCameraExtension* ext;
     static QList<QArvCameraId> cameraList;
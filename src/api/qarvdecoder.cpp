@@ -20,6 +20,7 @@
 #include "api/qarvdecoder.h"
 #include "decoders/swscaledecoder.h"
 #include "decoders/graymap.h"
+#include "decoders/parallelstrips.h"
 #include <opencv2/imgproc/imgproc.hpp>
 #include <QPluginLoader>
 #include <QMap>
@@ -147,6 +148,48 @@ void CV2QImageTemplate(const cv::Mat& image_, QImage& image) {
     }
 }
 
+void QArvDecoder::decodeInto(QByteArray frame, cv::Mat& image, QRect roi) {
+    decode(frame);
+    const cv::Mat decoded = getCvImage();
+    const cv::Rect rect = imageRect(roi, QSize(decoded.cols, decoded.rows));
+    image.create(rect.height, rect.width, decoded.type());
+    decoded(rect).copyTo(image);
+}
+
+bool QArvDecoder::decodeInto(QByteArray frame, void* data, size_t stride,
+                             QRect roi) {
+    const cv::Rect rect = imageRect(roi, imageSize());
+    const int type = cvType();
+    if (rect.area() == 0 || type < 0) {
+        logMessage() << "Decoder: nothing to decode into the given memory";
+        return false;
+    }
+    cv::Mat image(rect.height, rect.width, type, data, stride);
+    decodeInto(frame, image, roi);
+    // If the decoder did not keep to imageSize() and cvType(), OpenCV has
+    // reallocated the image and the caller's memory was never written.
+    if (image.data != data) {
+        logMessage() << "Decoder: decoded image does not fit the given memory,"
+                     << "expected" << rect.width << "x" << rect.height
+                     << "of type" << type << ", got" << image.cols << "x"
+                     << image.rows << "of type" << image.type();
+        return false;
+    }
+    return true;
+}
+
+QSize QArvDecoder::imageSize() {
+    const cv::Mat image = getCvImage();
+    return QSize(image.cols, image.rows);
+}
+
+cv::Rect QArvDecoder::imageRect(const QRect& roi, QSize size) {
+    const cv::Rect whole(0, 0, size.width(), size.height());
+    if (roi.isNull())
+        return whole;
+    return whole & cv::Rect(roi.x(), roi.y(), roi.width(), roi.height());
+}
+
 void QArvDecoder::CV2QImage(const cv::Mat& image, QImage& out) {
     switch (image.type()) {
     case CV_16UC1:
@@ -224,8 +267,12 @@ QArvDecoder* QArvDecoder::makeDecoder(QByteArray specification) {
     s >> size;
     if (type == "Aravis") {
         ArvPixelFormat fmt;
-        bool fast;
+        bool fast, preview = false;
         s >> fmt >> fast;
+        if (!s.atEnd())
+            s >> preview;
+        if (preview)
+            return QArvDecoder::makePreviewDecoder(fmt, size);
         return QArvDecoder::makeDecoder(fmt, size, fast);
     } else if (type == "SwScale") {
         static_assert(sizeof(AVPixelFormat) <= sizeof(qlonglong),
@@ -264,6 +311,21 @@ QArvDecoder* QArvDecoder::makeDecoder(ArvPixelFormat format,
     return NULL;
 }
 
+/*!
+ * Returns NULL if the format is not supported.
+ */
+QArvDecoder* QArvDecoder::makePreviewDecoder(ArvPixelFormat format,
+                                             QSize size) {
+    foreach (auto fmt, *pluginFormats) {
+        if (fmt->pixelFormat() == format) return fmt->makePreviewDecoder(size);
+    }
+    return NULL;
+}
+
+void QArvDecoder::setDecodingThreads(int threads) {
+    QArv::setStripThreads(threads);
+}
+
 /*!
  * Returns NULL if the format is not supported.
  */
@@ -276,17 +338,12 @@ QArvDecoder* QArvDecoder::makeSwScaleDecoder(AVPixelFormat fmt,
         return new QArv::SwScaleDecoder(size, fmt, 0);
 }
 
+/*
+ * Packed YUV and RGB formats have native decoders, see
+ * decoders/packedcolor.h. Only formats that libswscale alone can decode
+ * belong here.
+ */
 static QMap<ArvPixelFormat, AVPixelFormat> initSwScaleFormats() {
     QMap<ArvPixelFormat, AVPixelFormat> m;
-
-    m[ARV_PIXEL_FORMAT_YUV_422_PACKED] = AV_PIX_FMT_UYVY422;
-    m[ARV_PIXEL_FORMAT_RGB_8_PACKED] = AV_PIX_FMT_RGB24;
-    m[ARV_PIXEL_FORMAT_BGR_8_PACKED] = AV_PIX_FMT_BGR24;
-    m[ARV_PIXEL_FORMAT_RGBA_8_PACKED] = AV_PIX_FMT_RGBA;
-    m[ARV_PIXEL_FORMAT_BGRA_8_PACKED] = AV_PIX_FMT_BGRA;
-    m[ARV_PIXEL_FORMAT_YUV_411_PACKED] = AV_PIX_FMT_UYYVYY411;
-    m[ARV_PIXEL_FORMAT_YUV_422_PACKED] = AV_PIX_FMT_UYVY422;
-    m[ARV_PIXEL_FORMAT_YUV_422_YUYV_PACKED] = AV_PIX_FMT_YUYV422;
-
     return m;
 }
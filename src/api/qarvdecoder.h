@@ -24,6 +24,7 @@
 #include <QByteArray>
 #include <QString>
 #include <QSize>
+#include <QRect>
 #include <QImage>
 #include <QtPlugin>
 #include <opencv2/core/core.hpp>
@@ -58,6 +59,38 @@ public:
      */
     virtual const cv::Mat getCvImage() = 0;
 
+    /*!
+     * Decodes the given frame directly into the given image, avoiding the
+     * copy that would be needed to keep the result of getCvImage(). If roi is
+     * given, only that part of the decoded image is produced; it is clipped
+     * to the image. The image is reallocated, like cv::Mat::create() does,
+     * unless it already has the type given by cvType() and the size of the
+     * decoded image or roi, so it can be a header for any memory, such as
+     * a pooled buffer. Afterwards, the contents of getCvImage() are
+     * unspecified.
+     *
+     * The default implementation decodes and copies; decoders override it
+     * to write into the image directly.
+     */
+    virtual void decodeInto(QByteArray frame, cv::Mat& image,
+                            QRect roi = QRect());
+
+    /*!
+     * Like the above, but decodes into memory that is not managed by OpenCV.
+     * The memory must hold as many lines of the given stride as the decoded
+     * image or roi has. Returns false, and leaves the memory untouched, if the
+     * decoder produced an image of a different size or type than imageSize()
+     * and cvType() promised.
+     */
+    bool decodeInto(QByteArray frame, void* data, size_t stride,
+                    QRect roi = QRect());
+
+    /*!
+     * Returns the size of the decoded image, which is usually the size of
+     * the frame, but may be smaller for preview decoders.
+     */
+    virtual QSize imageSize();
+
     /*!
      * Returns the type of cv::Mat returned by getCvImage(). The decoder chooses
      * the most sensible type given the number of significant bits in input data.
@@ -99,10 +132,28 @@ public:
     static QArvDecoder* makeDecoder(ArvPixelFormat, QSize size,
                                     bool fast = true);
 
+    /*!
+     * Creates a decoder that trades resolution for speed, meant for display
+     * only. Its images may be smaller than the frame, e.g. half size for
+     * Bayer formats. Returns NULL if the format has no such decoder.
+     */
+    static QArvDecoder* makePreviewDecoder(ArvPixelFormat, QSize size);
+
+    /*!
+     * Sets the number of threads that decode a single frame, including the
+     * thread that calls decode(). The threads are shared by all decoders.
+     * If 0, the number of processor cores is used.
+     */
+    static void setDecodingThreads(int threads);
+
     //! Convenience function to create a libswscale decoder, not limited to Aravis pixel formats.
     static QArvDecoder* makeSwScaleDecoder(enum AVPixelFormat fmt,
                                            QSize size,
                                            int swsFlags = 0);
+
+protected:
+    //! Returns roi clipped to an image of the given size, or all of it if roi is null.
+    static cv::Rect imageRect(const QRect& roi, QSize size);
 };
 
 //! Interface for the plugin to generate a decoder for a particular format.
@@ -116,12 +167,15 @@ public:
     //! Instantiates a decoder using this plugin.
     virtual QArvDecoder* makeDecoder(QSize size) = 0;
 
+    //! Instantiates a preview decoder, see QArvDecoder::makePreviewDecoder().
+    virtual QArvDecoder* makePreviewDecoder(QSize) { return NULL; }
+
     //! Returns the list of supported pixel formats.
     static QList<ArvPixelFormat> supportedFormats();
 };
 
 Q_DECLARE_INTERFACE(QArvPixelFormat,
-                    "si.ad-vega.qarv.QArvPixelFormat/0.1")
+                    "si.ad-vega.qarv.QArvPixelFormat/0.2")
 
 #pragma GCC visibility pop
 
@@ -0,0 +1,34 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "api/qarvframe.h"
+
+QArvFrame::QArvFrame(QByteArray data, const QArvFrameMeta& meta) :
+    bytes(data), info(meta), buffer(nullptr) {}
+
+QArvFrame::QArvFrame(QByteArray data, const QArvFrameMeta& meta,
+                     ArvBuffer* buffer_, Releaser release_) :
+    bytes(data), info(meta), buffer(buffer_), release(release_) {}
+
+QArvFrame::~QArvFrame() {
+    // Drop the reference to the data first, it may point into the buffer.
+    bytes.clear();
+    if (buffer && release)
+        release(buffer);
+}
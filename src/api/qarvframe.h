@@ -0,0 +1,107 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QARVFRAME_H
+#define QARVFRAME_H
+
+#include <QByteArray>
+#include <QRect>
+#include <QSharedPointer>
+#include <QMetaType>
+#include <functional>
+
+#pragma GCC visibility push(default)
+
+struct _ArvBuffer;
+typedef _ArvBuffer ArvBuffer;
+
+//! Information about a frame, captured when the frame is received.
+/*!
+ * This is a plain value that travels with the frame through decoding,
+ * processing and recording, so that nobody needs to query the Aravis
+ * buffer, which may have been reused by then.
+ */
+struct QArvFrameMeta {
+    //! Frame ID as assigned by the camera.
+    quint64 frameId = 0;
+    //! Camera timestamp in nanoseconds.
+    quint64 timestamp = 0;
+    //! Host time of arrival in nanoseconds since the epoch.
+    quint64 systemTimestamp = 0;
+    //! The ArvBufferStatus of the buffer, zero means success.
+    int status = 0;
+    //! Size of the received payload in bytes.
+    quint64 payloadSize = 0;
+    //! Image region covered by the frame.
+    QRect roi;
+};
+
+//! A frame received from the camera, holding on to its Aravis buffer.
+/*!
+ * The buffer the frame was captured into is handed back to the stream only
+ * when the frame is destroyed. Frames are passed around as QArvFramePtr, so
+ * the data returned by data() remains valid, and is not overwritten by the
+ * camera, for as long as any reference to the frame exists. This is what
+ * makes it safe to pass frames to other threads without copying them.
+ *
+ * Holding on to frames for a long time takes buffers away from the stream
+ * and will eventually cause buffer underruns.
+ */
+class QArvFrame {
+public:
+    //! Wraps data that does not belong to a stream, such as a recorded frame.
+    explicit QArvFrame(QByteArray data = QByteArray(),
+                       const QArvFrameMeta& meta = QArvFrameMeta());
+    ~QArvFrame();
+
+    /*!
+     * Returns the raw frame data. It is empty if the frame is invalid. When
+     * the frame was acquired without copying, the array does not own the
+     * data, so it must not be kept after the frame itself is released.
+     */
+    QByteArray data() const { return bytes; }
+
+    //! Returns true if the frame is invalid or holds no data.
+    bool isEmpty() const { return bytes.isEmpty(); }
+
+    //! Returns the information captured together with the frame.
+    const QArvFrameMeta& meta() const { return info; }
+
+private:
+    typedef std::function<void(ArvBuffer*)> Releaser;
+    QArvFrame(QByteArray data, const QArvFrameMeta& meta,
+              ArvBuffer* buffer, Releaser release);
+    Q_DISABLE_COPY(QArvFrame)
+
+    QByteArray bytes;
+    QArvFrameMeta info;
+    ArvBuffer* buffer;
+    Releaser release;
+
+    friend class QArvCamera;
+};
+
+typedef QSharedPointer<QArvFrame> QArvFramePtr;
+
+Q_DECLARE_METATYPE(QArvFrameMeta)
+Q_DECLARE_METATYPE(QArvFramePtr)
+
+#pragma GCC visibility pop
+
+#endif
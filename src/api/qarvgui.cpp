@@ -85,14 +85,14 @@ QArvGui::~QArvGui() {
 void QArvGui::signalForwarding(bool enable) {
     if (enable) {
         connect(ext->mw->workthread,
-                SIGNAL(frameDelivered(QByteArray,ArvBuffer*)),
-                this, SIGNAL(frameReady(QByteArray,ArvBuffer*)));
+                SIGNAL(frameDelivered(QArvFramePtr)),
+                this, SIGNAL(frameReady(QArvFramePtr)));
         connect(ext->mw->workthread, SIGNAL(frameCooked(cv::Mat)),
                 this, SIGNAL(frameReady(cv::Mat)));
     } else {
         disconnect(ext->mw->workthread,
-                   SIGNAL(frameDelivered(QByteArray,ArvBuffer*)),
-                   this, SIGNAL(frameReady(QByteArray,ArvBuffer*)));
+                   SIGNAL(frameDelivered(QArvFramePtr)),
+                   this, SIGNAL(frameReady(QArvFramePtr)));
         disconnect(ext->mw->workthread, SIGNAL(frameCooked(cv::Mat)),
                    this, SIGNAL(frameReady(cv::Mat)));
     }
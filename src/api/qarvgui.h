@@ -89,10 +89,9 @@ signals:
      * If the QArvGui will not be used to display frames, connecting
      * to this signal and using QArvDecoder is more efficient.
      *
-     * \param raw Undecoded buffer. May be empty if the received frame was invalid. Be aware that, depending on the settings in the GUI, this data may be overwritten if not used or copied soon enough.
-     * \param rawAravisBuffer See QArvCamera::getFrame().
+     * \param raw Undecoded frame. Its data may be empty if the received frame was invalid. The camera will not overwrite the data while a reference to the frame is held, but holding it for too long will cause buffer underruns.
      */
-    void frameReady(QByteArray raw, ArvBuffer* rawAravisBuffer);
+    void frameReady(QArvFramePtr raw);
 
     //! Emitted when a new frame arrives from the processing thread.
     /*!
@@ -100,7 +99,7 @@ signals:
      * and (possibly) process them. In that case, connecting to this signal
      * is more efficient than using the raw frame and decoding it again.
      *
-     * \param processed The frame as seen in the GUI video display. May be empty if the received frame was invalid. It is not copied, use cv::Mat::clone() if necessary.
+     * \param processed The frame as seen in the GUI video display. May be empty if the received frame was invalid. It is not copied and is shared with other receivers, so it must not be modified; use cv::Mat::clone() if necessary.
      */
     void frameReady(cv::Mat processed);
 
@@ -0,0 +1,183 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bufferpool.h"
+#include "globals.h"
+#include <cerrno>
+#include <cstring>
+
+extern "C" {
+#include <arv.h>
+#include <sys/mman.h>
+#include <unistd.h>
+}
+
+using namespace QArv;
+
+// Idle buffers are kept for this many distinct payload sizes, so that
+// switching back and forth between two ROIs does not reallocate.
+static const int retainedSizes = 2;
+
+static const size_t hugePageSize = 2 << 20;
+
+namespace
+{
+
+struct Mapping {
+    void* address;
+    size_t length;
+    bool locked;
+};
+
+}
+
+static void unmapBuffer(gpointer data) {
+    auto mapping = static_cast<Mapping*>(data);
+    if (mapping->locked)
+        munlock(mapping->address, mapping->length);
+    munmap(mapping->address, mapping->length);
+    delete mapping;
+}
+
+static size_t payloadSize(ArvBuffer* buffer) {
+    size_t size;
+#ifdef ARAVIS_OLD_BUFFER
+    size = buffer->size;
+#else
+    arv_buffer_get_data(buffer, &size);
+#endif
+    return size;
+}
+
+BufferPool::BufferPool() :
+    lockPages(false), hugePages(false),
+    lockFailureReported(false), hugeFailureReported(false) {}
+
+BufferPool::~BufferPool() {
+    clear();
+}
+
+void BufferPool::setOptions(bool lockPages_, bool hugePages_) {
+    QMutexLocker l(&lock);
+    lockPages = lockPages_;
+    hugePages = hugePages_;
+}
+
+ArvBuffer* BufferPool::allocate(size_t size) {
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    void* address = MAP_FAILED;
+    size_t length = 0;
+
+#ifdef MAP_HUGETLB
+    if (hugePages) {
+        length = (size + hugePageSize - 1) / hugePageSize * hugePageSize;
+        address = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                       flags | MAP_HUGETLB, -1, 0);
+        if (address == MAP_FAILED && !hugeFailureReported) {
+            hugeFailureReported = true;
+            logMessage() << "Huge pages are not available for frame buffers:"
+                         << strerror(errno);
+        }
+    }
+#endif
+    if (address == MAP_FAILED) {
+        length = (size + pageSize - 1) / pageSize * pageSize;
+        address = mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (address == MAP_FAILED) {
+            logMessage() << "Unable to allocate a frame buffer:"
+                         << strerror(errno);
+            return nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        if (hugePages)
+            madvise(address, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    // Fault every page in now rather than when the first frames arrive.
+    auto bytes = static_cast<volatile char*>(address);
+    for (size_t i = 0; i < length; i += pageSize)
+        bytes[i] = 0;
+
+    bool locked = false;
+    if (lockPages) {
+        locked = mlock(address, length) == 0;
+        if (!locked && !lockFailureReported) {
+            lockFailureReported = true;
+            logMessage() << "Unable to lock frame buffers in memory:"
+                         << strerror(errno);
+        }
+    }
+
+    auto mapping = new Mapping { address, length, locked };
+    return arv_buffer_new_full(size, address, mapping, unmapBuffer);
+}
+
+QList<ArvBuffer*> BufferPool::take(size_t size, uint count) {
+    QMutexLocker l(&lock);
+    recentSizes.removeAll(size);
+    recentSizes.prepend(size);
+
+    QList<ArvBuffer*> buffers;
+    auto& bucket = idle[size];
+    while (count > 0 && !bucket.isEmpty()) {
+        buffers << bucket.takeLast();
+        count--;
+    }
+    for (; count > 0; count--) {
+        auto buffer = allocate(size);
+        if (!buffer)
+            break;
+        buffers << buffer;
+    }
+    trim();
+    return buffers;
+}
+
+void BufferPool::recycle(ArvBuffer* buffer) {
+    const size_t size = payloadSize(buffer);
+    QMutexLocker l(&lock);
+    if (recentSizes.contains(size))
+        idle[size] << buffer;
+    else
+        g_object_unref(buffer);
+}
+
+void BufferPool::trim() {
+    while (recentSizes.size() > retainedSizes) {
+        const size_t size = recentSizes.takeLast();
+        foreach (auto buffer, idle.take(size)) {
+            g_object_unref(buffer);
+        }
+    }
+}
+
+void BufferPool::clear() {
+    QMutexLocker l(&lock);
+    foreach (const auto& bucket, idle) {
+        foreach (auto buffer, bucket) {
+            g_object_unref(buffer);
+        }
+    }
+    idle.clear();
+}
@@ -0,0 +1,78 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <cstddef>
+
+struct _ArvBuffer;
+typedef _ArvBuffer ArvBuffer;
+
+namespace QArv
+{
+
+/*
+ * A pool of Aravis buffers that outlives individual streams, so that
+ * restarting acquisition does not reallocate (and page-fault) the whole frame
+ * queue. Idle buffers are kept in buckets keyed by payload size. take()
+ * hands the pool's reference to a buffer over to the caller, and recycle()
+ * hands it back; streams and frames hold their own on top of that.
+ *
+ * Memory is mapped directly, prefaulted and optionally locked into RAM and/or
+ * backed by huge pages. It is unmapped when the buffer is finalized.
+ *
+ * All functions are thread-safe.
+ */
+class BufferPool {
+public:
+    BufferPool();
+    ~BufferPool();
+
+    // Takes effect for buffers allocated from now on.
+    void setOptions(bool lockPages, bool hugePages);
+
+    // Returns count buffers of the given payload size, reusing idle ones
+    // where possible. Idle buffers of other sizes beyond the most recently
+    // used ones are freed.
+    QList<ArvBuffer*> take(size_t size, uint count);
+
+    // Returns a buffer to the pool once no stream or frame uses it.
+    void recycle(ArvBuffer* buffer);
+
+    // Frees all idle buffers.
+    void clear();
+
+private:
+    ArvBuffer* allocate(size_t size);
+    void trim();
+
+    QMutex lock;
+    QMap<size_t, QList<ArvBuffer*> > idle;
+    QList<size_t> recentSizes;
+    bool lockPages, hugePages;
+    bool lockFailureReported, hugeFailureReported;
+};
+
+}
+
+#endif
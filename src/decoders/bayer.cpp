@@ -46,6 +46,16 @@ Q_IMPORT_PLUGIN(BayerGB12_PACKED)
 #endif
 Q_IMPORT_PLUGIN(BayerBG12_PACKED)
 
+Q_IMPORT_PLUGIN(BayerGR10P)
+Q_IMPORT_PLUGIN(BayerRG10P)
+Q_IMPORT_PLUGIN(BayerGB10P)
+Q_IMPORT_PLUGIN(BayerBG10P)
+
+Q_IMPORT_PLUGIN(BayerGR12P)
+Q_IMPORT_PLUGIN(BayerRG12P)
+Q_IMPORT_PLUGIN(BayerGB12P)
+Q_IMPORT_PLUGIN(BayerBG12P)
+
 #ifdef ARV_PIXEL_FORMAT_BAYER_GR_16
 Q_IMPORT_PLUGIN(BayerGR16)
 Q_IMPORT_PLUGIN(BayerRG16)
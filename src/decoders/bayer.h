@@ -25,24 +25,34 @@
 // we check for their presence. The 12_PACKED formats
 // were added individually. The required ifdefs are in
 // the respective headers.
+// The PFNC packed formats are defined in
+// decoders/pfnc.h when aravis lacks them.
 
 #include "bayer/BayerBG10.h"
+#include "bayer/BayerBG10P.h"
 #include "bayer/BayerBG12.h"
+#include "bayer/BayerBG12P.h"
 #include "bayer/BayerBG12_PACKED.h"
 #include "bayer/BayerBG16.h"
 #include "bayer/BayerBG8.h"
 #include "bayer/BayerGB10.h"
+#include "bayer/BayerGB10P.h"
 #include "bayer/BayerGB12.h"
+#include "bayer/BayerGB12P.h"
 #include "bayer/BayerGB12_PACKED.h"
 #include "bayer/BayerGB16.h"
 #include "bayer/BayerGB8.h"
 #include "bayer/BayerGR10.h"
+#include "bayer/BayerGR10P.h"
 #include "bayer/BayerGR12.h"
+#include "bayer/BayerGR12P.h"
 #include "bayer/BayerGR12_PACKED.h"
 #include "bayer/BayerGR16.h"
 #include "bayer/BayerGR8.h"
 #include "bayer/BayerRG10.h"
+#include "bayer/BayerRG10P.h"
 #include "bayer/BayerRG12.h"
+#include "bayer/BayerRG12P.h"
 #include "bayer/BayerRG12_PACKED.h"
 #include "bayer/BayerRG16.h"
 #include "bayer/BayerRG8.h"
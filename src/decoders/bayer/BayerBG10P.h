@@ -0,0 +1,23 @@
+#pragma once
+
+#include "decoder.h"
+
+namespace QArv
+{
+
+class BayerBG10P : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.BayerBG10P")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_BAYER_BG_10P; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_BG_10P>(size);
+    }
+    QArvDecoder* makePreviewDecoder(QSize size) override {
+        return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_BG_10P>(size, true);
+    }
+};
+
+}
@@ -15,6 +15,9 @@ public:
     QArvDecoder* makeDecoder(QSize size) override {
         return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_BG_12>(size);
     }
+    QArvDecoder* makePreviewDecoder(QSize size) override {
+        return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_BG_12>(size, true);
+    }
 };
 
 }
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "decoder.h"
+
+namespace QArv
+{
+
+class BayerBG12P : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.BayerBG12P")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_BAYER_BG_12P; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_BG_12P>(size);
+    }
+    QArvDecoder* makePreviewDecoder(QSize size) override {
+        return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_BG_12P>(size, true);
+    }
+};
+
+}
@@ -17,6 +17,9 @@ public:
     QArvDecoder* makeDecoder(QSize size) override {
         return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_BG_16>(size);
     }
+    QArvDecoder* makePreviewDecoder(QSize size) override {
+        return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_BG_16>(size, true);
+    }
 };
 
 #endif
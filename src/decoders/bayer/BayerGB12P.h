@@ -0,0 +1,23 @@
+#pragma once
+
+#include "decoder.h"
+
+namespace QArv
+{
+
+class BayerGB12P : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.BayerGB12P")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_BAYER_GB_12P; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_GB_12P>(size);
+    }
+    QArvDecoder* makePreviewDecoder(QSize size) override {
+        return new BayerDecoder<ARV_PIXEL_FORMAT_BAYER_GB_12P>(size, true);
+    }
+};
+
+}
@@ -1,7 +1,12 @@
 #pragma once
 
 #include "api/qarvdecoder.h"
+#include "decoders/unpackers.h"
+#include "decoders/parallelstrips.h"
+#include "decoders/pfnc.h"
 #include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <memory>
 #include <QDataStream>
 extern "C" {
   #include <arv.h>
@@ -13,21 +18,31 @@ namespace QArv
 template <ArvPixelFormat fmt>
 class BayerDecoder : public QArvDecoder {
 public:
-    BayerDecoder(QSize size_) : size(size_),
-        decoded(size.height(), size.width(), cvType()) {
+    /*
+     * In preview mode, each 2x2 cell of the mosaic becomes a single pixel,
+     * giving a half-size image at a fraction of the cost of demosaicing.
+     */
+    BayerDecoder(QSize size_, bool preview_ = false) : size(size_),
+        decoded(preview_ ? size.height() / 2 : size.height(),
+                preview_ ? size.width() / 2 : size.width(), cvType()),
+        preview(preview_) {
         switch (fmt) {
         case ARV_PIXEL_FORMAT_BAYER_GR_10:
         case ARV_PIXEL_FORMAT_BAYER_RG_10:
         case ARV_PIXEL_FORMAT_BAYER_GB_10:
         case ARV_PIXEL_FORMAT_BAYER_BG_10:
-            stage1 = QArvDecoder::makeDecoder(ARV_PIXEL_FORMAT_MONO_10, size);
+            stage1Format = ARV_PIXEL_FORMAT_MONO_10;
+            fused = true;
+            shift = 6;
             break;
 
         case ARV_PIXEL_FORMAT_BAYER_GR_12:
         case ARV_PIXEL_FORMAT_BAYER_RG_12:
         case ARV_PIXEL_FORMAT_BAYER_GB_12:
         case ARV_PIXEL_FORMAT_BAYER_BG_12:
-            stage1 = QArvDecoder::makeDecoder(ARV_PIXEL_FORMAT_MONO_12, size);
+            stage1Format = ARV_PIXEL_FORMAT_MONO_12;
+            fused = true;
+            shift = 4;
             break;
 
 #ifdef ARV_PIXEL_FORMAT_BAYER_GR_12_PACKED
@@ -40,11 +55,40 @@ public:
         case ARV_PIXEL_FORMAT_BAYER_GB_12_PACKED:
 #endif
         case ARV_PIXEL_FORMAT_BAYER_BG_12_PACKED:
-            stage1 = QArvDecoder::makeDecoder(ARV_PIXEL_FORMAT_MONO_12_PACKED,
-                                              size);
+            stage1Format = ARV_PIXEL_FORMAT_MONO_12_PACKED;
+            fused = true;
+            unpack = unpackMono12Packed;
+            packedBits = 12;
+            break;
+
+        case ARV_PIXEL_FORMAT_BAYER_GR_10P:
+        case ARV_PIXEL_FORMAT_BAYER_RG_10P:
+        case ARV_PIXEL_FORMAT_BAYER_GB_10P:
+        case ARV_PIXEL_FORMAT_BAYER_BG_10P:
+            stage1Format = ARV_PIXEL_FORMAT_MONO_10_P;
+            fused = true;
+            unpack = unpackMono10p;
+            packedBits = 10;
+            break;
+
+        case ARV_PIXEL_FORMAT_BAYER_GR_12P:
+        case ARV_PIXEL_FORMAT_BAYER_RG_12P:
+        case ARV_PIXEL_FORMAT_BAYER_GB_12P:
+        case ARV_PIXEL_FORMAT_BAYER_BG_12P:
+            stage1Format = ARV_PIXEL_FORMAT_MONO_12_P;
+            fused = true;
+            unpack = unpackMono12p;
+            packedBits = 12;
             break;
         }
 
+        if (fused && !preview) {
+            // Unpacked input and the demosaiced strip take 8 bytes per pixel.
+            const int rowBytes = 8 * std::max(1, size.width());
+            stripRows =
+                std::max<int>(minStripRows, cacheBudget / rowBytes) & ~1;
+        }
+
         switch (fmt) {
         case ARV_PIXEL_FORMAT_BAYER_GR_8:
             cvt = cv::COLOR_BayerGB2BGR;
@@ -133,7 +177,33 @@ public:
         case ARV_PIXEL_FORMAT_BAYER_BG_12_PACKED:
             cvt = cv::COLOR_BayerRG2BGR;
             break;
+
+        case ARV_PIXEL_FORMAT_BAYER_GR_10P:
+        case ARV_PIXEL_FORMAT_BAYER_GR_12P:
+            cvt = cv::COLOR_BayerGB2BGR;
+            break;
+
+        case ARV_PIXEL_FORMAT_BAYER_RG_10P:
+        case ARV_PIXEL_FORMAT_BAYER_RG_12P:
+            cvt = cv::COLOR_BayerBG2BGR;
+            break;
+
+        case ARV_PIXEL_FORMAT_BAYER_GB_10P:
+        case ARV_PIXEL_FORMAT_BAYER_GB_12P:
+            cvt = cv::COLOR_BayerGR2BGR;
+            break;
+
+        case ARV_PIXEL_FORMAT_BAYER_BG_10P:
+        case ARV_PIXEL_FORMAT_BAYER_BG_12P:
+            cvt = cv::COLOR_BayerRG2BGR;
+            break;
         }
+
+        // OpenCV names the patterns by the second row, starting with the
+        // second column.
+        redRow = cvt == cv::COLOR_BayerRG2BGR || cvt == cv::COLOR_BayerGR2BGR;
+        redColumn = cvt == cv::COLOR_BayerGB2BGR
+                    || cvt == cv::COLOR_BayerRG2BGR;
     };
 
     const cv::Mat getCvImage() override { return decoded; }
@@ -157,10 +227,19 @@ public:
         QByteArray b;
         QDataStream s(&b, QIODevice::WriteOnly);
         s << QString("Aravis") << size << pixelFormat() << false;
+        if (preview)
+            s << true;
         return b;
     }
 
     void decode(QByteArray frame) override {
+        decodeInto(frame, decoded, QRect());
+    }
+
+    void decodeInto(QByteArray frame, cv::Mat& image, QRect roi) override {
+        const cv::Rect rect =
+            imageRect(roi, QSize(decoded.cols, decoded.rows));
+        image.create(rect.height, rect.width, cvType());
         // Workaround: cv::Mat has no const data constructor, but data need
         // not be copied, as QByteArray::data() does.
         void* data =
@@ -183,19 +262,142 @@ public:
 
 #endif
         default:
+            if (fused && !preview && decodeFused(frame, image, rect))
+                return;
+            // Previews and frames that the fused path cannot handle are
+            // unpacked whole.
+            if (!stage1)
+                stage1.reset(QArvDecoder::makeDecoder(stage1Format, size));
             stage1->decode(frame);
             tmp = stage1->getCvImage();
             break;
         }
-        cv::cvtColor(tmp, decoded, cvt);
+        if (preview) {
+            if (tmp.depth() == CV_8U)
+                superpixel<uint8_t>(tmp, image, rect);
+            else
+                superpixel<uint16_t>(tmp, image, rect);
+        } else if (rect.size() == tmp.size()) {
+            cv::cvtColor(tmp, image, cvt);
+        } else {
+            // Only the lines around roi are demosaiced, starting at an even
+            // one to keep the Bayer phase.
+            const int first = std::max(0, (rect.y & ~1) - halo);
+            const int last = std::min(tmp.rows, rect.y + rect.height + halo);
+            cv::cvtColor(tmp.rowRange(first, last),
+                         decoded.rowRange(first, last), cvt);
+            decoded(rect).copyTo(image);
+        }
     }
 
 private:
+    // Takes red and blue as they are and averages the greens.
+    template <typename T>
+    void superpixel(const cv::Mat& raw, cv::Mat& image, const cv::Rect& rect) {
+        const int blueRow = 1 - redRow, blueColumn = 1 - redColumn;
+        forEachStrip(rect.height, rect.width, 1, [&] (int begin, int end) {
+            for (int y = begin; y < end; y++) {
+                const int row = 2 * (rect.y + y);
+                const T* redLine = raw.ptr<T>(row + redRow) + 2 * rect.x;
+                const T* blueLine = raw.ptr<T>(row + blueRow) + 2 * rect.x;
+                T* out = image.ptr<T>(y);
+                for (int x = 0; x < rect.width; x++) {
+                    const uint green = redLine[2 * x + blueColumn]
+                                       + blueLine[2 * x + redColumn];
+                    out[3 * x] = blueLine[2 * x + blueColumn];
+                    out[3 * x + 1] = (green + 1) / 2;
+                    out[3 * x + 2] = redLine[2 * x + redColumn];
+                }
+            }
+        });
+    }
+
+    /*
+     * Unpacks and demosaics a strip of rows at a time, so that the unpacked
+     * image never has to leave the cache. Each strip is extended by a halo
+     * of rows whose output is discarded. The halo is even in order to keep
+     * the Bayer phase, and covers the neighbourhood used by cvtColor(), so
+     * the result is the same as when demosaicing the whole image at once.
+     * Returns false if the frame is too short or packed lines do not end on
+     * a byte boundary, in which case stage1 is used.
+     *
+     * The lines of rect, starting with an even one, are divided among the
+     * decoding threads, each of which then goes through its part a strip at
+     * a time using its own scratch.
+     */
+    bool decodeFused(const QByteArray& frame, cv::Mat& image,
+                     const cv::Rect& rect) {
+        const int w = size.width(), h = size.height();
+        const size_t rowBits = size_t(w) * (unpack ? packedBits : 16);
+        const size_t rowBytes = rowBits / 8;
+        if (rowBits % 8 || size_t(frame.size()) < rowBytes * h)
+            return false;
+        const uchar* data = reinterpret_cast<const uchar*>(frame.constData());
+        const int base = rect.y & ~1;
+        const auto parts = splitIntoStrips(rect.y + rect.height - base, w, 2);
+        while (rawStrips.size() < parts.size()) {
+            rawStrips << cv::Mat(stripRows + 2 * halo, w, CV_16UC1);
+            bgrStrips << cv::Mat(stripRows + 2 * halo, w, CV_16UC3);
+        }
+        cv::Mat* raw = rawStrips.data();
+        cv::Mat* bgr = bgrStrips.data();
+        runStrips(parts, [&] (int index, int begin, int end) {
+            for (int y = base + begin; y < base + end; y += stripRows)
+                decodeStrip(data, rowBytes, y,
+                            std::min(base + end, y + stripRows),
+                            raw[index], bgr[index], image, rect);
+        });
+        return true;
+    }
+
+    void decodeStrip(const uchar* data, size_t rowBytes, int begin, int end,
+                     cv::Mat& rawStrip, cv::Mat& bgrStrip,
+                     cv::Mat& image, const cv::Rect& rect) {
+        const int first = std::max(0, begin - halo);
+        const int last = std::min(size.height(), end + halo);
+        cv::Mat raw = rawStrip.rowRange(0, last - first);
+        cv::Mat bgr = bgrStrip.rowRange(0, last - first);
+        const uchar* in = data + first * rowBytes;
+        if (unpack)
+            unpack(in, (last - first) * rowBytes,
+                   raw.ptr<uint16_t>(0), raw.total());
+        else
+            shiftMono16(reinterpret_cast<const uint16_t*>(in),
+                        raw.ptr<uint16_t>(0), raw.total(), shift);
+        cv::cvtColor(raw, bgr, cvt);
+        const int from = std::max(begin, rect.y);
+        const int to = std::min(end, rect.y + rect.height);
+        if (from < to)
+            bgr(cv::Rect(rect.x, from - first, rect.width, to - from))
+                .copyTo(image.rowRange(from - rect.y, to - rect.y));
+    }
+
+    enum {
+        // Scratch memory per strip; should stay within the L2 cache.
+        cacheBudget = 512 * 1024,
+        minStripRows = 16,
+        halo = 2,
+    };
+
     QSize size;
     cv::Mat tmp;
     cv::Mat decoded;
-    QArvDecoder* stage1;
-    int cvt;
+    // Unpacks whole frames of formats that are not plain 8 or 16-bit.
+    std::unique_ptr<QArvDecoder> stage1;
+    ArvPixelFormat stage1Format = 0;
+    int cvt = -1;
+    bool preview;
+    // Position of the red pixel in each 2x2 cell.
+    int redRow = 0, redColumn = 0;
+    // Whether the input is decoded strip by strip, see decodeFused().
+    bool fused = false;
+    // Unpacks packed input, or if NULL, 16-bit input is shifted instead.
+    size_t (*unpack)(const uint8_t*, size_t, uint16_t*, size_t) = nullptr;
+    uint packedBits = 0;
+    uint shift = 0;
+    int stripRows = 0;
+    // Scratch for each part of the frame decoded in parallel.
+    QVector<cv::Mat> rawStrips, bgrStrips;
 };
 
 }
@@ -18,6 +18,8 @@
  */
 
 #include "decoders/mono12packed.h"
+#include "decoders/unpackers.h"
+#include "decoders/parallelstrips.h"
 
 using namespace QArv;
 
@@ -25,39 +27,47 @@ Mono12PackedDecoder::Mono12PackedDecoder(QSize size_) :
     size(size_), M(size_.height(), size_.width(), CV_16U) {}
 
 
-void Mono12PackedDecoder::decode(QByteArray frame) {
+// Unpacks count pixels beginning with the given one.
+static void unpack(const QByteArray& frame, size_t first, size_t count,
+                   uint16_t* out) {
     const uchar* dta = reinterpret_cast<const uchar*>(frame.constData());
-    const int h = size.height(), w = size.width();
-
-    int line = 0;
-    auto linestart = M.ptr<uint16_t>(0);
-    int outcurrent = 0;
-    const uchar* inptr = dta;
-    uint16_t pixel;
-    uchar* bytes = reinterpret_cast<uchar*>(&pixel);
-    while (inptr < dta + frame.size()) {
-        bytes[0] = inptr[1] << 4;
-        bytes[1] = inptr[0];
-        linestart[outcurrent++] = pixel;
-
-        if (outcurrent == w) {
-            if (++line == h) break;
-            linestart = M.ptr<uint16_t>(line);
-            outcurrent = 0;
-        }
+    const size_t bytes = frame.size();
+    // An odd pixel is the second one of its group of three bytes.
+    if (count > 0 && first % 2) {
+        const size_t offset = first / 2 * 3;
+        if (offset + 3 > bytes)
+            return;
+        *out++ = dta[offset + 2] << 8 | (dta[offset + 1] & 0xF0);
+        first++;
+        count--;
+    }
+    const size_t offset = first / 2 * 3;
+    if (offset < bytes)
+        unpackMono12Packed(dta + offset, bytes - offset, out, count);
+}
 
-        bytes[0] = inptr[1] & 0xF0;
-        bytes[1] = inptr[2];
-        linestart[outcurrent++] = pixel;
+void Mono12PackedDecoder::decode(QByteArray frame) {
+    decodeInto(frame, M, QRect());
+}
 
-        if (outcurrent == w) {
-            if (++line == h) break;
-            linestart = M.ptr<uint16_t>(line);
-            outcurrent = 0;
+void Mono12PackedDecoder::decodeInto(QByteArray frame, cv::Mat& image,
+                                     QRect roi) {
+    const cv::Rect rect = imageRect(roi, size);
+    image.create(rect.height, rect.width, CV_16UC1);
+    const size_t w = size.width();
+    // The packed data runs on across line ends, so whole lines can be
+    // unpacked in one go if the image is continuous.
+    const bool wholeLines = rect.width == size.width() && image.isContinuous();
+    forEachStrip(rect.height, rect.width, 1, [&] (int begin, int end) {
+        if (wholeLines) {
+            unpack(frame, (rect.y + begin) * w, (end - begin) * w,
+                   image.ptr<uint16_t>(begin));
+            return;
         }
-
-        inptr += 3;
-    }
+        for (int y = begin; y < end; y++)
+            unpack(frame, (rect.y + y) * w + rect.x, rect.width,
+                   image.ptr<uint16_t>(y));
+    });
 }
 
 const cv::Mat Mono12PackedDecoder::getCvImage() {
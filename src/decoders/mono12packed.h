@@ -33,6 +33,7 @@ public:
     Mono12PackedDecoder(QSize size_);
     void decode(QByteArray frame) override;
     const cv::Mat getCvImage() override;
+    void decodeInto(QByteArray frame, cv::Mat& image, QRect roi) override;
     int cvType() override { return CV_16UC1; }
     ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_MONO_12_PACKED; }
     QByteArray decoderSpecification() override;
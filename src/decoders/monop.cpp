@@ -0,0 +1,88 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decoders/monop.h"
+#include "decoders/unpackers.h"
+#include "decoders/parallelstrips.h"
+
+using namespace QArv;
+
+MonoPDecoder::MonoPDecoder(QSize size_, ArvPixelFormat format_) :
+    size(size_), format(format_),
+    bits(format_ == ARV_PIXEL_FORMAT_MONO_10_P ? 10 : 12),
+    M(size_.height(), size_.width(), CV_16U) {}
+
+// Unpacks count pixels beginning with the given one.
+void MonoPDecoder::unpack(const QByteArray& frame, size_t first, size_t count,
+                          uint16_t* out) {
+    const uchar* dta = reinterpret_cast<const uchar*>(frame.constData());
+    const size_t bytes = frame.size();
+    // Pixels up to the start of a byte are taken one at a time. Each of
+    // them fits into the two bytes it starts in.
+    for (; count > 0 && first * bits % 8; first++, count--) {
+        const size_t offset = first * bits / 8;
+        if (offset + 2 > bytes)
+            return;
+        const uint window = dta[offset] | dta[offset + 1] << 8;
+        *out++ = (window >> (first * bits % 8)) << (16 - bits) & 0xFFFF;
+    }
+    const size_t offset = first * bits / 8;
+    if (offset >= bytes)
+        return;
+    if (bits == 10)
+        unpackMono10p(dta + offset, bytes - offset, out, count);
+    else
+        unpackMono12p(dta + offset, bytes - offset, out, count);
+}
+
+void MonoPDecoder::decode(QByteArray frame) {
+    decodeInto(frame, M, QRect());
+}
+
+void MonoPDecoder::decodeInto(QByteArray frame, cv::Mat& image, QRect roi) {
+    const cv::Rect rect = imageRect(roi, size);
+    image.create(rect.height, rect.width, CV_16UC1);
+    const size_t w = size.width();
+    const bool wholeLines = rect.width == size.width() && image.isContinuous();
+    forEachStrip(rect.height, rect.width, 1, [&] (int begin, int end) {
+        if (wholeLines) {
+            unpack(frame, (rect.y + begin) * w, (end - begin) * w,
+                   image.ptr<uint16_t>(begin));
+            return;
+        }
+        for (int y = begin; y < end; y++)
+            unpack(frame, (rect.y + y) * w + rect.x, rect.width,
+                   image.ptr<uint16_t>(y));
+    });
+}
+
+const cv::Mat MonoPDecoder::getCvImage() {
+    return M;
+}
+
+QByteArray MonoPDecoder::decoderSpecification() {
+    QByteArray b;
+    QDataStream s(&b, QIODevice::WriteOnly);
+    s << QString("Aravis") << size << pixelFormat() << false;
+    return b;
+}
+
+
+Q_IMPORT_PLUGIN(Mono10pFormat)
+Q_IMPORT_PLUGIN(Mono12pFormat)
@@ -0,0 +1,79 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MONOP_H
+#define MONOP_H
+
+#include "api/qarvdecoder.h"
+#include "decoders/pfnc.h"
+
+namespace QArv
+{
+
+/*
+ * Decodes the GenICam PFNC Mono10p and Mono12p formats, in which pixels
+ * follow each other without padding, not even at the end of a line.
+ */
+class MonoPDecoder : public QArvDecoder {
+public:
+    MonoPDecoder(QSize size_, ArvPixelFormat format_);
+    void decode(QByteArray frame) override;
+    const cv::Mat getCvImage() override;
+    void decodeInto(QByteArray frame, cv::Mat& image, QRect roi) override;
+    int cvType() override { return CV_16UC1; }
+    ArvPixelFormat pixelFormat() override { return format; }
+    QByteArray decoderSpecification() override;
+
+private:
+    void unpack(const QByteArray& frame, size_t first, size_t count,
+                uint16_t* out);
+
+    QSize size;
+    ArvPixelFormat format;
+    uint bits;
+    cv::Mat M;
+};
+
+class Mono10pFormat : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.Mono10pFormat")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_MONO_10_P; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new MonoPDecoder(size, ARV_PIXEL_FORMAT_MONO_10_P);
+    }
+};
+
+class Mono12pFormat : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.Mono12pFormat")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_MONO_12_P; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new MonoPDecoder(size, ARV_PIXEL_FORMAT_MONO_12_P);
+    }
+};
+
+}
+
+#endif
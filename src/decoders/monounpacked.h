@@ -21,7 +21,11 @@
 #define MONOUNPACKED_H
 
 #include <type_traits>
+#include <algorithm>
+#include <cstring>
 #include "api/qarvdecoder.h"
+#include "decoders/unpackers.h"
+#include "decoders/parallelstrips.h"
 
 namespace QArv
 {
@@ -59,25 +63,95 @@ public:
     int cvType() override { return cvMatType; };
 
     void decode(QByteArray frame) override {
+        const size_t pixels = size_t(size.width()) * size.height();
+        // Short frames only fill the beginning of the image.
+        const size_t available =
+            std::min(pixels, size_t(frame.size()) / sizeof(InputType));
         const InputType* dta =
             reinterpret_cast<const InputType*>(frame.constData());
-        const int h = size.height(), w = size.width();
-        for (int i = 0; i < h; i++) {
-            auto line = M.ptr<OutputType>(i);
-            for (int j = 0; j < w; j++) {
-                OutputType tmp;
-                if (typeIsSigned)
-                    tmp = dta[i * w + j] + (1<<signedShiftBits);
-                else
-                    tmp = dta[i * w + j];
-                line[j] = tmp << (zeroBits);
-            }
-        }
+        decodePixels(dta, available,
+                     std::integral_constant<bool, IsPassThrough>());
     }
 
     const cv::Mat getCvImage() override {
         return M;
     }
+
+    void decodeInto(QByteArray frame, cv::Mat& image, QRect roi) override {
+        const cv::Rect rect = imageRect(roi, size);
+        image.create(rect.height, rect.width, cvMatType);
+        const size_t w = size.width();
+        const size_t available = std::min(w * size.height(),
+                                          frame.size() / sizeof(InputType));
+        const InputType* dta =
+            reinterpret_cast<const InputType*>(frame.constData());
+        forEachStrip(rect.height, rect.width, 1, [&] (int begin, int end) {
+            for (int y = begin; y < end; y++) {
+                const size_t first =
+                    std::min(available, (rect.y + y) * w + rect.x);
+                const size_t last = std::min(available, first + rect.width);
+                OutputType* line = image.ptr<OutputType>(y);
+                if (IsPassThrough)
+                    std::memcpy(line, dta + first,
+                                (last - first) * sizeof(InputType));
+                else
+                    convert(dta + first, line, last - first);
+            }
+        });
+    }
+
+private:
+    // Data that needs neither shifting nor offsetting is used as it is.
+    static const bool IsPassThrough =
+        std::is_same<InputType, OutputType>::value && zeroBits == 0;
+
+    void decodePixels(const InputType* dta, size_t available,
+                      std::true_type) {
+        OutputType* out = M.ptr<OutputType>(0);
+        forEachPixelStrip(available, [&] (size_t first, size_t count) {
+            std::memcpy(out + first, dta + first, count * sizeof(InputType));
+        });
+    }
+
+    void decodePixels(const InputType* dta, size_t available,
+                      std::false_type) {
+        OutputType* out = M.ptr<OutputType>(0);
+        forEachPixelStrip(available, [&] (size_t first, size_t count) {
+            convert(dta + first, out + first, count);
+        });
+    }
+
+    // Splits the first available pixels of the image into strips of lines.
+    template <typename Function>
+    void forEachPixelStrip(size_t available, Function body) {
+        const size_t w = size.width();
+        forEachStrip(size.height(), w, 1, [&] (int begin, int end) {
+            const size_t first = std::min(available, begin * w);
+            const size_t last = std::min(available, end * w);
+            if (first < last)
+                body(first, last - first);
+        });
+    }
+
+    static void convert(const uint16_t* in, uint16_t* out, size_t pixels) {
+        shiftMono16(in, out, pixels, zeroBits);
+    }
+
+    static void convert(const int8_t* in, uint8_t* out, size_t pixels) {
+        offsetMono8Signed(in, out, pixels);
+    }
+
+    template <typename In, typename Out>
+    static void convert(const In* in, Out* out, size_t pixels) {
+        for (size_t i = 0; i < pixels; i++) {
+            Out tmp;
+            if (typeIsSigned)
+                tmp = in[i] + (1<<signedShiftBits);
+            else
+                tmp = in[i];
+            out[i] = tmp << zeroBits;
+        }
+    }
 };
 
 }
@@ -0,0 +1,30 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decoders/packedcolor.h"
+
+using namespace QArv;
+
+Q_IMPORT_PLUGIN(Yuv422PackedFormat)
+Q_IMPORT_PLUGIN(Yuv422YuyvPackedFormat)
+Q_IMPORT_PLUGIN(Yuv411PackedFormat)
+Q_IMPORT_PLUGIN(Rgb8PackedFormat)
+Q_IMPORT_PLUGIN(Bgr8PackedFormat)
+Q_IMPORT_PLUGIN(Rgba8PackedFormat)
+Q_IMPORT_PLUGIN(Bgra8PackedFormat)
@@ -0,0 +1,284 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACKEDCOLOR_H
+#define PACKEDCOLOR_H
+
+#include "api/qarvdecoder.h"
+#include "decoders/unpackers.h"
+#include "decoders/parallelstrips.h"
+#include "globals.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <QDataStream>
+#include <QVector>
+extern "C" {
+  #include <arv.h>
+}
+
+namespace QArv
+{
+
+/*
+ * Decodes the packed YUV and RGB formats into BGR, which is what OpenCV
+ * uses. The conversions are done by OpenCV, a strip of lines at a time.
+ * YUV411 is first expanded to YUV422, which OpenCV supports. BGR needs no
+ * conversion, so the decoded image refers to the frame when possible.
+ */
+template <ArvPixelFormat fmt>
+class PackedColorDecoder : public QArvDecoder {
+public:
+    PackedColorDecoder(QSize size_) : size(size_),
+        M(size_.height(), size_.width(), CV_8UC3) {
+        switch (fmt) {
+        case ARV_PIXEL_FORMAT_YUV_422_PACKED:
+            inputType = CV_8UC2;
+            cvt = cv::COLOR_YUV2BGR_UYVY;
+            groupPixels = 2;
+            groupBytes = 4;
+            break;
+
+        case ARV_PIXEL_FORMAT_YUV_422_YUYV_PACKED:
+            inputType = CV_8UC2;
+            cvt = cv::COLOR_YUV2BGR_YUYV;
+            groupPixels = 2;
+            groupBytes = 4;
+            break;
+
+        case ARV_PIXEL_FORMAT_YUV_411_PACKED:
+            cvt = cv::COLOR_YUV2BGR_UYVY;
+            groupPixels = 4;
+            groupBytes = 6;
+            break;
+
+        case ARV_PIXEL_FORMAT_RGB_8_PACKED:
+            cvt = cv::COLOR_RGB2BGR;
+            break;
+
+        case ARV_PIXEL_FORMAT_RGBA_8_PACKED:
+            inputType = CV_8UC4;
+            cvt = cv::COLOR_RGBA2BGR;
+            groupBytes = 4;
+            break;
+
+        case ARV_PIXEL_FORMAT_BGRA_8_PACKED:
+            inputType = CV_8UC4;
+            cvt = cv::COLOR_BGRA2BGR;
+            groupBytes = 4;
+            break;
+        }
+        lineBytes = size_t(size.width()) / groupPixels * groupBytes;
+        OK = size.width() > 0 && size.width() % groupPixels == 0;
+        if (size.width() % groupPixels)
+            logMessage() << "Frame width must be a multiple of" << groupPixels
+                         << "for this pixel format.";
+        // The scratch for a strip takes at most 5 bytes per pixel.
+        const int rowBytes = 5 * std::max(1, size.width());
+        stripRows = std::max<int>(minStripRows, cacheBudget / rowBytes);
+    }
+
+    const cv::Mat getCvImage() override { return M; }
+
+    int cvType() override { return CV_8UC3; }
+
+    ArvPixelFormat pixelFormat() override { return fmt; }
+
+    QByteArray decoderSpecification() override {
+        QByteArray b;
+        QDataStream s(&b, QIODevice::WriteOnly);
+        s << QString("Aravis") << size << pixelFormat() << false;
+        return b;
+    }
+
+    void decode(QByteArray frame) override {
+        decodeInto(frame, M, QRect());
+    }
+
+    void decodeInto(QByteArray frame, cv::Mat& image, QRect roi) override {
+        const cv::Rect rect = imageRect(roi, size);
+        image.create(rect.height, rect.width, CV_8UC3);
+        if (!OK)
+            return;
+        // Pixels that share chroma are converted together, so the columns
+        // are extended to whole groups. If that changes them, each strip is
+        // converted into scratch first.
+        const int first = rect.x / groupPixels * groupPixels;
+        const int last = (rect.x + rect.width + groupPixels - 1)
+                         / groupPixels * groupPixels;
+        const bool direct = first == rect.x
+                            && last == rect.x + rect.width;
+        // Short frames only fill the beginning of the image.
+        const int lines = std::min<size_t>(rect.y + rect.height,
+                                           frame.size() / lineBytes);
+        const uchar* data =
+            reinterpret_cast<const uchar*>(frame.constData())
+            + first / groupPixels * groupBytes;
+        const auto parts = splitIntoStrips(rect.height, rect.width);
+        while (expandedStrips.size() < parts.size()) {
+            expandedStrips << cv::Mat();
+            bgrStrips << cv::Mat();
+        }
+        cv::Mat* expanded = expandedStrips.data();
+        cv::Mat* bgr = bgrStrips.data();
+        runStrips(parts, [&] (int index, int begin, int end) {
+            end = std::min(end, lines - rect.y);
+            for (int y = begin; y < end; y += stripRows) {
+                const int rows = std::min(end - y, stripRows);
+                const uchar* in = data + (rect.y + y) * lineBytes;
+                cv::Mat src;
+                if (fmt == ARV_PIXEL_FORMAT_YUV_411_PACKED) {
+                    expanded[index].create(rows, last - first, CV_8UC2);
+                    for (int i = 0; i < rows; i++)
+                        expandYuv411(in + i * lineBytes,
+                                     (last - first) / groupPixels * groupBytes,
+                                     expanded[index].ptr(i), last - first);
+                    src = expanded[index];
+                } else {
+                    // Workaround: cv::Mat has no const data constructor.
+                    src = cv::Mat(rows, last - first, inputType,
+                                  const_cast<uchar*>(in), lineBytes);
+                }
+                cv::Mat dst = image.rowRange(y, y + rows);
+                if (direct) {
+                    convert(src, dst);
+                } else {
+                    convert(src, bgr[index]);
+                    bgr[index].colRange(rect.x - first,
+                                        rect.x - first + rect.width)
+                        .copyTo(dst);
+                }
+            }
+        });
+    }
+
+private:
+    void convert(const cv::Mat& src, cv::Mat& dst) {
+        if (fmt == ARV_PIXEL_FORMAT_BGR_8_PACKED)
+            src.copyTo(dst);
+        else
+            cv::cvtColor(src, dst, cvt);
+    }
+
+    enum {
+        // Scratch memory per strip; should stay within the L2 cache.
+        cacheBudget = 512 * 1024,
+        minStripRows = 16,
+    };
+
+    QSize size;
+    cv::Mat M;
+    bool OK;
+    int inputType = CV_8UC3;
+    int cvt = -1;
+    // Pixels that share chroma, and the bytes they take.
+    int groupPixels = 1;
+    int groupBytes = 3;
+    size_t lineBytes;
+    int stripRows;
+    // Scratch for each part of the frame decoded in parallel.
+    QVector<cv::Mat> expandedStrips, bgrStrips;
+};
+
+class Yuv422PackedFormat : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.Yuv422PackedFormat")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_YUV_422_PACKED; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new PackedColorDecoder<ARV_PIXEL_FORMAT_YUV_422_PACKED>(size);
+    }
+};
+
+class Yuv422YuyvPackedFormat : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.Yuv422YuyvPackedFormat")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_YUV_422_YUYV_PACKED; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new PackedColorDecoder<ARV_PIXEL_FORMAT_YUV_422_YUYV_PACKED>(size);
+    }
+};
+
+class Yuv411PackedFormat : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.Yuv411PackedFormat")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_YUV_411_PACKED; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new PackedColorDecoder<ARV_PIXEL_FORMAT_YUV_411_PACKED>(size);
+    }
+};
+
+class Rgb8PackedFormat : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.Rgb8PackedFormat")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_RGB_8_PACKED; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new PackedColorDecoder<ARV_PIXEL_FORMAT_RGB_8_PACKED>(size);
+    }
+};
+
+class Bgr8PackedFormat : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.Bgr8PackedFormat")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_BGR_8_PACKED; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new PackedColorDecoder<ARV_PIXEL_FORMAT_BGR_8_PACKED>(size);
+    }
+};
+
+class Rgba8PackedFormat : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.Rgba8PackedFormat")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_RGBA_8_PACKED; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new PackedColorDecoder<ARV_PIXEL_FORMAT_RGBA_8_PACKED>(size);
+    }
+};
+
+class Bgra8PackedFormat : public QObject, public QArvPixelFormat {
+    Q_OBJECT
+    Q_INTERFACES(QArvPixelFormat)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.Bgra8PackedFormat")
+
+public:
+    ArvPixelFormat pixelFormat() override { return ARV_PIXEL_FORMAT_BGRA_8_PACKED; }
+    QArvDecoder* makeDecoder(QSize size) override {
+        return new PackedColorDecoder<ARV_PIXEL_FORMAT_BGRA_8_PACKED>(size);
+    }
+};
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decoders/parallelstrips.h"
+#include <QMutex>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <atomic>
+
+using namespace QArv;
+
+// Smaller strips cost more in handing them out than is gained.
+static const int minStripPixels = 1 << 17;
+
+namespace
+{
+
+// One frame's worth of strips. Whichever thread comes first takes the next
+// strip, so it does not matter if the pool is busy with other frames.
+struct Batch {
+    QVector<Strip> strips;
+    const std::function<void(int, int, int)>* body;
+    std::atomic<int> next{0};
+    int finished = 0;
+    QMutex lock;
+    QWaitCondition allFinished;
+
+    void work() {
+        int done = 0;
+        int i;
+        while ((i = next.fetch_add(1)) < strips.size()) {
+            (*body)(i, strips[i].begin, strips[i].end);
+            done++;
+        }
+        if (done > 0) {
+            QMutexLocker l(&lock);
+            finished += done;
+            if (finished == strips.size())
+                allFinished.wakeAll();
+        }
+    }
+};
+
+// Tasks may only start after the batch is done, so they share ownership.
+class StripTask : public QRunnable {
+public:
+    explicit StripTask(QSharedPointer<Batch> batch) : batch(batch) {}
+    void run() override { batch->work(); }
+
+private:
+    QSharedPointer<Batch> batch;
+};
+
+std::atomic<int> threadsPerFrame{0};
+
+QThreadPool* pool() {
+    static QThreadPool* threads = [] () {
+        auto p = new QThreadPool;
+        p->setExpiryTimeout(-1);
+        p->setMaxThreadCount(qMax(1, stripThreads() - 1));
+        return p;
+    }();
+    return threads;
+}
+
+}
+
+void QArv::setStripThreads(int threads) {
+    threadsPerFrame.store(qMax(0, threads));
+    pool()->setMaxThreadCount(qMax(1, stripThreads() - 1));
+}
+
+int QArv::stripThreads() {
+    const int threads = threadsPerFrame.load();
+    return threads > 0 ? threads : qMax(1, QThread::idealThreadCount());
+}
+
+QVector<Strip> QArv::splitIntoStrips(int rows, int cols, int alignment) {
+    const qint64 pixels = qint64(rows) * cols;
+    const int count = qBound<qint64>(1, pixels / minStripPixels,
+                                     stripThreads());
+    int height = (rows + count - 1) / count;
+    height = (height + alignment - 1) / alignment * alignment;
+    QVector<Strip> strips;
+    for (int begin = 0; begin < rows; begin += qMax(1, height))
+        strips << Strip{begin, qMin(rows, begin + qMax(1, height))};
+    return strips;
+}
+
+void QArv::runStrips(const QVector<Strip>& strips,
+                     const std::function<void(int, int, int)>& body) {
+    if (strips.size() == 1)
+        body(0, strips[0].begin, strips[0].end);
+    if (strips.size() <= 1)
+        return;
+
+    QSharedPointer<Batch> batch(new Batch);
+    batch->strips = strips;
+    batch->body = &body;
+    const int helpers = qMin(strips.size() - 1, pool()->maxThreadCount());
+    for (int i = 0; i < helpers; i++)
+        pool()->start(new StripTask(batch));
+    batch->work();
+    QMutexLocker l(&batch->lock);
+    while (batch->finished < strips.size())
+        batch->allFinished.wait(&batch->lock);
+}
+
+void QArv::forEachStrip(int rows, int cols, int alignment,
+                        const std::function<void(int, int)>& body) {
+    runStrips(splitIntoStrips(rows, cols, alignment),
+              [&body] (int, int begin, int end) { body(begin, end); });
+}
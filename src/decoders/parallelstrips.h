@@ -0,0 +1,63 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decoding a large frame in one thread leaves the other cores idle, so
+ * decoders split frames into horizontal strips and decode them on a set of
+ * threads shared by all decoders. The threads are started once and kept;
+ * the thread that asks for a frame to be decoded works on strips as well.
+ */
+
+#ifndef PARALLELSTRIPS_H
+#define PARALLELSTRIPS_H
+
+#include <QVector>
+#include <functional>
+
+namespace QArv
+{
+
+// Rows [begin, end) of an image.
+struct Strip {
+    int begin, end;
+};
+
+/*
+ * Splits rows into at most one strip per decoding thread. Strips begin at
+ * multiples of alignment, e.g. 2 to keep the Bayer phase. Images too small
+ * to be worth splitting give a single strip.
+ */
+QVector<Strip> splitIntoStrips(int rows, int cols, int alignment = 1);
+
+// Calls body for each strip and returns once all calls have returned.
+void runStrips(const QVector<Strip>& strips,
+               const std::function<void(int index, int begin, int end)>& body);
+
+// Shorthand for splitting and running.
+void forEachStrip(int rows, int cols, int alignment,
+                  const std::function<void(int begin, int end)>& body);
+
+// Number of threads that decode a single frame, including the caller. If 0,
+// the number of cores is used.
+void setStripThreads(int threads);
+int stripThreads();
+
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Codes of the GenICam PFNC packed formats, for aravis versions that do not
+ * define them. Cameras can deliver them either way.
+ */
+
+#ifndef PFNC_H
+#define PFNC_H
+
+extern "C" {
+  #include <arv.h>
+}
+
+#ifndef ARV_PIXEL_FORMAT_MONO_10_P
+#define ARV_PIXEL_FORMAT_MONO_10_P ((ArvPixelFormat) 0x010a0046u)
+#endif
+#ifndef ARV_PIXEL_FORMAT_MONO_12_P
+#define ARV_PIXEL_FORMAT_MONO_12_P ((ArvPixelFormat) 0x010c0047u)
+#endif
+
+#ifndef ARV_PIXEL_FORMAT_BAYER_BG_10P
+#define ARV_PIXEL_FORMAT_BAYER_BG_10P ((ArvPixelFormat) 0x010a0052u)
+#endif
+#ifndef ARV_PIXEL_FORMAT_BAYER_BG_12P
+#define ARV_PIXEL_FORMAT_BAYER_BG_12P ((ArvPixelFormat) 0x010c0053u)
+#endif
+#ifndef ARV_PIXEL_FORMAT_BAYER_GB_10P
+#define ARV_PIXEL_FORMAT_BAYER_GB_10P ((ArvPixelFormat) 0x010a0054u)
+#endif
+#ifndef ARV_PIXEL_FORMAT_BAYER_GB_12P
+#define ARV_PIXEL_FORMAT_BAYER_GB_12P ((ArvPixelFormat) 0x010c0055u)
+#endif
+#ifndef ARV_PIXEL_FORMAT_BAYER_GR_10P
+#define ARV_PIXEL_FORMAT_BAYER_GR_10P ((ArvPixelFormat) 0x010a0056u)
+#endif
+#ifndef ARV_PIXEL_FORMAT_BAYER_GR_12P
+#define ARV_PIXEL_FORMAT_BAYER_GR_12P ((ArvPixelFormat) 0x010c0057u)
+#endif
+#ifndef ARV_PIXEL_FORMAT_BAYER_RG_10P
+#define ARV_PIXEL_FORMAT_BAYER_RG_10P ((ArvPixelFormat) 0x010a0058u)
+#endif
+#ifndef ARV_PIXEL_FORMAT_BAYER_RG_12P
+#define ARV_PIXEL_FORMAT_BAYER_RG_12P ((ArvPixelFormat) 0x010c0059u)
+#endif
+
+#endif
@@ -18,6 +18,7 @@
  */
 
 #include "decoders/swscaledecoder.h"
+#include "decoders/parallelstrips.h"
 #include <cstdlib>
 #include <opencv2/core/types_c.h>
 #include "globals.h"
@@ -26,14 +27,49 @@ extern "C" {
 #include <libavutil/pixdesc.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/mem.h>
+#include <libavutil/opt.h>
 }
 
 using namespace QArv;
 
+#ifdef HAVE_SWS_SCALE_FRAME
+/*
+ * Returns a context that converts the frame in slices on libswscale's own
+ * threads, or NULL if there is only one decoding thread or libswscale does
+ * not support threads.
+ */
+static SwsContext* threadedContext(QSize size, AVPixelFormat input,
+                                   AVPixelFormat output, int flags) {
+    const int threads = stripThreads();
+    if (threads < 2)
+        return NULL;
+    SwsContext* c = sws_alloc_context();
+    if (!c)
+        return NULL;
+    if (av_opt_set_int(c, "srcw", size.width(), 0) < 0
+        || av_opt_set_int(c, "srch", size.height(), 0) < 0
+        || av_opt_set_int(c, "src_format", input, 0) < 0
+        || av_opt_set_int(c, "dstw", size.width(), 0) < 0
+        || av_opt_set_int(c, "dsth", size.height(), 0) < 0
+        || av_opt_set_int(c, "dst_format", output, 0) < 0
+        || av_opt_set_int(c, "sws_flags", flags, 0) < 0
+        || av_opt_set_int(c, "threads", threads, 0) < 0
+        || sws_init_context(c, NULL, NULL) < 0) {
+        sws_freeContext(c);
+        return NULL;
+    }
+    return c;
+}
+
+// AVFrames only borrow the memory they are given.
+static void keepData(void*, uint8_t*) {}
+#endif
+
 SwScaleDecoder::SwScaleDecoder(QSize size_, AVPixelFormat inputPixfmt_,
                                ArvPixelFormat arvPixFmt, int swsFlags) :
     size(size_),
-    inputPixfmt(inputPixfmt_), arvPixelFormat(arvPixFmt), flags(swsFlags) {
+    sliceable(false), threaded(false), planes(1), inputPixfmt(inputPixfmt_),
+    arvPixelFormat(arvPixFmt), flags(swsFlags) {
     if (size.width() != (size.width() / 2) * 2
         || size.height() != (size.height() / 2) * 2) {
         logMessage() << "Frame size must be factor of two for SwScaleDecoder.";
@@ -71,9 +107,21 @@ SwScaleDecoder::SwScaleDecoder(QSize size_, AVPixelFormat inputPixfmt_,
                 bufferBytesPerPixel = 3;
             }
         }
+#ifdef HAVE_FMT_DESC_GET
+        // Without vertical chroma subsampling, each line is converted on
+        // its own, so strips give the same result as the whole frame.
+        sliceable = av_pix_fmt_desc_get(inputPixfmt)->log2_chroma_h == 0;
+        planes = av_pix_fmt_count_planes(inputPixfmt);
+#endif
         OK = 0 < av_image_alloc(image_pointers, image_strides, size.width(),
                                 size.height(), outputPixFmt, 16);
-        if (OK)
+#ifdef HAVE_SWS_SCALE_FRAME
+        if (OK && !sliceable) {
+            ctx = threadedContext(size, inputPixfmt, outputPixFmt, flags);
+            threaded = ctx != NULL;
+        }
+#endif
+        if (OK && !threaded)
             ctx = sws_getContext(size.width(), size.height(), inputPixfmt,
                                  size.width(), size.height(), outputPixFmt,
                                  flags, 0, 0, 0);
@@ -87,6 +135,9 @@ SwScaleDecoder::SwScaleDecoder(QSize size_, AVPixelFormat inputPixfmt_,
 SwScaleDecoder::~SwScaleDecoder() {
     if (OK) {
         sws_freeContext(ctx);
+        foreach (auto stripContext, stripContexts) {
+            sws_freeContext(stripContext);
+        }
         av_freep(&image_pointers[0]);
     }
 }
@@ -105,18 +156,107 @@ int SwScaleDecoder::cvType() {
 
 void SwScaleDecoder::decode(QByteArray frame) {
     if (!OK) return;
+    convert(frame, image_pointers[0], image_strides[0]);
+}
+
+void SwScaleDecoder::decodeInto(QByteArray frame, cv::Mat& image, QRect roi) {
+    const cv::Rect rect = imageRect(roi, size);
+    if (!OK || rect.size() != cv::Size(size.width(), size.height())) {
+        QArvDecoder::decodeInto(frame, image, roi);
+        return;
+    }
+    image.create(size.height(), size.width(), cvMatType);
+    convert(frame, image.data, image.step);
+}
+
+// The output formats all have a single plane.
+void SwScaleDecoder::convert(const QByteArray& frame, uint8_t* destination,
+                             int stride) {
+    int strides[4] = { stride };
     auto dataptr = reinterpret_cast<const uint8_t*>(frame.constData());
     av_image_fill_arrays(srcInfo.data, srcInfo.linesize,
                          const_cast<uint8_t*>(dataptr),
                          inputPixfmt, size.width(), size.height(), 1);
-    int outheight = sws_scale(ctx, srcInfo.data, srcInfo.linesize,
-                              0, size.height(),
-                              image_pointers, image_strides);
-    if (outheight != size.height()) {
-        logMessage() << "swscale error! outheight =" << outheight;
+#ifdef HAVE_SWS_SCALE_FRAME
+    if (threaded) {
+        convertFrame(frame.size(), destination, stride);
+        return;
+    }
+#endif
+    const auto strips = sliceable
+                        ? splitIntoStrips(size.height(), size.width(), 2)
+                        : QVector<Strip>();
+    if (strips.size() <= 1) {
+        uint8_t* dst[4] = { destination };
+        int outheight = sws_scale(ctx, srcInfo.data, srcInfo.linesize,
+                                  0, size.height(), dst, strides);
+        if (outheight != size.height()) {
+            logMessage() << "swscale error! outheight =" << outheight;
+        }
+        return;
+    }
+
+    // Contexts are only recreated when the strips change.
+    stripContexts.resize(qMax(stripContexts.size(), strips.size()));
+    for (int i = 0; i < strips.size(); i++) {
+        const int height = strips[i].end - strips[i].begin;
+        stripContexts[i] = sws_getCachedContext(stripContexts[i],
+                                                size.width(), height,
+                                                inputPixfmt,
+                                                size.width(), height,
+                                                outputPixFmt,
+                                                flags, 0, 0, 0);
     }
+    auto contexts = stripContexts.data();
+    runStrips(strips, [&] (int index, int begin, int end) {
+        // All planes have full height; the palette, if any, is shared.
+        const uint8_t* src[4];
+        for (int i = 0; i < 4; i++)
+            src[i] = i < planes
+                     ? srcInfo.data[i] + begin * srcInfo.linesize[i]
+                     : srcInfo.data[i];
+        uint8_t* dst[4] = { destination + begin * stride };
+        int outheight = sws_scale(contexts[index], src, srcInfo.linesize,
+                                  0, end - begin, dst, strides);
+        if (outheight != end - begin) {
+            logMessage() << "swscale error! outheight =" << outheight;
+        }
+    });
 }
 
+#ifdef HAVE_SWS_SCALE_FRAME
+// Converts the frame set up by convert() with a threaded context.
+void SwScaleDecoder::convertFrame(int frameSize, uint8_t* destination,
+                                  int stride) {
+    AVFrame* src = av_frame_alloc();
+    AVFrame* dst = av_frame_alloc();
+    if (src && dst) {
+        src->format = inputPixfmt;
+        src->width = size.width();
+        src->height = size.height();
+        for (int i = 0; i < 4; i++) {
+            src->data[i] = srcInfo.data[i];
+            src->linesize[i] = srcInfo.linesize[i];
+        }
+        src->buf[0] = av_buffer_create(srcInfo.data[0], frameSize, keepData,
+                                       NULL, AV_BUFFER_FLAG_READONLY);
+        dst->format = outputPixFmt;
+        dst->width = size.width();
+        dst->height = size.height();
+        dst->data[0] = destination;
+        dst->linesize[0] = stride;
+        dst->buf[0] = av_buffer_create(destination, stride * size.height(),
+                                       keepData, NULL, 0);
+    }
+    if (!src || !dst || !src->buf[0] || !dst->buf[0]
+        || sws_scale_frame(ctx, dst, src) < 0) {
+        logMessage() << "swscale error!";
+    }
+    av_frame_free(&src);
+    av_frame_free(&dst);
+}
+#endif
+
 const cv::Mat SwScaleDecoder::getCvImage() {
     if (!OK) return cv::Mat();
     cv::Mat M(size.height(), size.width(), cvMatType,
@@ -127,6 +267,6 @@ const cv::Mat SwScaleDecoder::getCvImage() {
 QByteArray SwScaleDecoder::decoderSpecification() {
     QByteArray b;
     QDataStream s(&b, QIODevice::WriteOnly);
-    s << QString("SwScale") << size << (qlonglong)outputPixFmt << flags;
+    s << QString("SwScale") << size << (qlonglong)inputPixfmt << flags;
     return b;
 }
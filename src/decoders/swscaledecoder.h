@@ -23,6 +23,7 @@
 #include <gio/gio.h>  // Workaround for gdbusintrospection's use of "signal".
 #include <QSize>
 #include <QImage>
+#include <QVector>
 #include <api/qarvdecoder.h>
 
 extern "C" {
@@ -46,15 +47,28 @@ public:
     virtual ~SwScaleDecoder();
     void decode(QByteArray frame) override;
     const cv::Mat getCvImage() override;
+    void decodeInto(QByteArray frame, cv::Mat& image, QRect roi) override;
     int cvType() override;
     ArvPixelFormat pixelFormat() override;
     QByteArray decoderSpecification() override;
     enum AVPixelFormat swscalePixelFormat();
 
 private:
+    void convert(const QByteArray& frame, uint8_t* destination, int stride);
+#ifdef HAVE_SWS_SCALE_FRAME
+    void convertFrame(int frameSize, uint8_t* destination, int stride);
+#endif
+
     bool OK;
     QSize size;
     struct SwsContext* ctx;
+    // Formats without vertical chroma subsampling are converted in strips,
+    // each with its own context. Others are converted by ctx, which may
+    // use libswscale's own threads.
+    bool sliceable;
+    bool threaded;
+    int planes;
+    QVector<struct SwsContext*> stripContexts;
     uint8_t* image_pointers[4];
     int image_strides[4];
     uint8_t bufferBytesPerPixel;
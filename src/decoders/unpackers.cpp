@@ -0,0 +1,582 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decoders/unpackers.h"
+#include <algorithm>
+#include <string>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QARV_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace QArv
+{
+
+size_t unpackMono12PackedScalar(const uint8_t* in, size_t inBytes,
+                                uint16_t* out, size_t pixels) {
+    // A lone byte at the end holds half a pixel; two bytes hold one.
+    pixels = std::min(pixels, inBytes / 3 * 2 + (inBytes % 3 == 2));
+    size_t i = 0;
+    for (; i + 1 < pixels; i += 2, in += 3) {
+        out[i] = in[0] << 8 | (in[1] & 0x0F) << 4;
+        out[i + 1] = in[2] << 8 | (in[1] & 0xF0);
+    }
+    if (i < pixels)
+        out[i] = in[0] << 8 | (in[1] & 0x0F) << 4;
+    return pixels;
+}
+
+/*
+ * In PFNC packed formats, each pixel spans two bytes of the stream, so it
+ * can be read from a little-endian 16-bit window.
+ */
+static inline uint16_t streamPixel(const uint8_t* in, size_t bit,
+                                   unsigned bits) {
+    const uint8_t* p = in + bit / 8;
+    return (p[0] | p[1] << 8) >> bit % 8 << (16 - bits);
+}
+
+size_t unpackMono10pScalar(const uint8_t* in, size_t inBytes,
+                           uint16_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes * 8 / 10);
+    size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        const uint8_t* p = in + i / 4 * 5;
+        out[i] = (p[0] | p[1] << 8) << 6;
+        out[i + 1] = ((p[1] | p[2] << 8) << 4) & 0xFFC0;
+        out[i + 2] = ((p[2] | p[3] << 8) << 2) & 0xFFC0;
+        out[i + 3] = (p[3] | p[4] << 8) & 0xFFC0;
+    }
+    for (; i < pixels; i++)
+        out[i] = streamPixel(in, i * 10, 10);
+    return pixels;
+}
+
+size_t unpackMono12pScalar(const uint8_t* in, size_t inBytes,
+                           uint16_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes * 8 / 12);
+    size_t i = 0;
+    for (; i + 2 <= pixels; i += 2) {
+        const uint8_t* p = in + i / 2 * 3;
+        out[i] = (p[0] | p[1] << 8) << 4;
+        out[i + 1] = (p[1] | p[2] << 8) & 0xFFF0;
+    }
+    for (; i < pixels; i++)
+        out[i] = streamPixel(in, i * 12, 12);
+    return pixels;
+}
+
+size_t expandYuv411Scalar(const uint8_t* in, size_t inBytes,
+                          uint8_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes / 6 * 4) / 4 * 4;
+    for (size_t i = 0; i < pixels; i += 4, in += 6, out += 8) {
+        out[0] = out[4] = in[0];
+        out[1] = in[1];
+        out[2] = out[6] = in[3];
+        out[3] = in[2];
+        out[5] = in[4];
+        out[7] = in[5];
+    }
+    return pixels;
+}
+
+#ifdef QARV_X86_DISPATCH
+
+/*
+ * Each group of three bytes a, b, c is spread over two 16-bit lanes as
+ * (a << 8 | b) and (c << 8 | b). The high byte is then kept as is, and the
+ * low byte is replaced with the appropriate nibble of b: multiplying by 16
+ * moves the low nibble up in even lanes, odd lanes are multiplied by one.
+ */
+
+__attribute__((target("ssse3")))
+static size_t unpackMono12PackedSSSE3(const uint8_t* in, size_t inBytes,
+                                      uint16_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes / 3 * 2 + (inBytes % 3 == 2));
+    const __m128i spread = _mm_setr_epi8(1, 0, 1, 2, 4, 3, 4, 5,
+                                         7, 6, 7, 8, 10, 9, 10, 11);
+    const __m128i nibbleShift = _mm_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1);
+    const __m128i highMask = _mm_set1_epi16(0xFF00);
+    const __m128i lowMask = _mm_set1_epi16(0x00F0);
+    size_t i = 0;
+    // 8 pixels from 12 bytes, but the load reads 16.
+    for (; i + 8 <= pixels && i / 2 * 3 + 16 <= inBytes; i += 8) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(in + i / 2 * 3));
+        v = _mm_shuffle_epi8(v, spread);
+        __m128i low = _mm_and_si128(_mm_mullo_epi16(v, nibbleShift), lowMask);
+        v = _mm_or_si128(_mm_and_si128(v, highMask), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+    }
+    unpackMono12PackedScalar(in + i / 2 * 3, inBytes - i / 2 * 3,
+                             out + i, pixels - i);
+    return pixels;
+}
+
+__attribute__((target("avx2")))
+static size_t unpackMono12PackedAVX2(const uint8_t* in, size_t inBytes,
+                                     uint16_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes / 3 * 2 + (inBytes % 3 == 2));
+    // The shuffle works within 128-bit halves, so each half gets its own
+    // group of 12 bytes.
+    const __m256i spread = _mm256_setr_epi8(1, 0, 1, 2, 4, 3, 4, 5,
+                                            7, 6, 7, 8, 10, 9, 10, 11,
+                                            1, 0, 1, 2, 4, 3, 4, 5,
+                                            7, 6, 7, 8, 10, 9, 10, 11);
+    const __m256i nibbleShift = _mm256_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1,
+                                                  16, 1, 16, 1, 16, 1, 16, 1);
+    const __m256i highMask = _mm256_set1_epi16(0xFF00);
+    const __m256i lowMask = _mm256_set1_epi16(0x00F0);
+    size_t i = 0;
+    // 16 pixels from 24 bytes, but the second load reads up to byte 28.
+    for (; i + 16 <= pixels && i / 2 * 3 + 28 <= inBytes; i += 16) {
+        const uint8_t* p = in + i / 2 * 3;
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+        v = _mm256_shuffle_epi8(v, spread);
+        __m256i low = _mm256_and_si256(_mm256_mullo_epi16(v, nibbleShift),
+                                       lowMask);
+        v = _mm256_or_si256(_mm256_and_si256(v, highMask), low);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+    }
+    unpackMono12PackedSSSE3(in + i / 2 * 3, inBytes - i / 2 * 3,
+                            out + i, pixels - i);
+    return pixels;
+}
+
+/*
+ * PFNC formats are spread into 16-bit lanes holding the two bytes each pixel
+ * spans. Multiplying by a power of two shifts each lane so that its pixel
+ * ends up in the top bits, and the bits of the neighbour below are masked.
+ */
+
+__attribute__((target("ssse3")))
+static size_t unpackMono10pSSSE3(const uint8_t* in, size_t inBytes,
+                                 uint16_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes * 8 / 10);
+    const __m128i spread = _mm_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4,
+                                         5, 6, 6, 7, 7, 8, 8, 9);
+    const __m128i scale = _mm_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1);
+    const __m128i mask = _mm_set1_epi16(0xFFC0);
+    size_t i = 0;
+    // 8 pixels from 10 bytes, but the load reads 16.
+    for (; i + 8 <= pixels && i / 4 * 5 + 16 <= inBytes; i += 8) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(in + i / 4 * 5));
+        v = _mm_mullo_epi16(_mm_shuffle_epi8(v, spread), scale);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_and_si128(v, mask));
+    }
+    unpackMono10pScalar(in + i / 4 * 5, inBytes - i / 4 * 5,
+                        out + i, pixels - i);
+    return pixels;
+}
+
+__attribute__((target("avx2")))
+static size_t unpackMono10pAVX2(const uint8_t* in, size_t inBytes,
+                                uint16_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes * 8 / 10);
+    const __m256i spread = _mm256_setr_epi8(0, 1, 1, 2, 2, 3, 3, 4,
+                                            5, 6, 6, 7, 7, 8, 8, 9,
+                                            0, 1, 1, 2, 2, 3, 3, 4,
+                                            5, 6, 6, 7, 7, 8, 8, 9);
+    const __m256i scale = _mm256_setr_epi16(64, 16, 4, 1, 64, 16, 4, 1,
+                                            64, 16, 4, 1, 64, 16, 4, 1);
+    const __m256i mask = _mm256_set1_epi16(0xFFC0);
+    size_t i = 0;
+    // 16 pixels from 20 bytes, but the second load reads up to byte 26.
+    for (; i + 16 <= pixels && i / 4 * 5 + 26 <= inBytes; i += 16) {
+        const uint8_t* p = in + i / 4 * 5;
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 10)), 1);
+        v = _mm256_mullo_epi16(_mm256_shuffle_epi8(v, spread), scale);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            _mm256_and_si256(v, mask));
+    }
+    unpackMono10pSSSE3(in + i / 4 * 5, inBytes - i / 4 * 5,
+                       out + i, pixels - i);
+    return pixels;
+}
+
+__attribute__((target("ssse3")))
+static size_t unpackMono12pSSSE3(const uint8_t* in, size_t inBytes,
+                                 uint16_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes * 8 / 12);
+    const __m128i spread = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5,
+                                         6, 7, 7, 8, 9, 10, 10, 11);
+    const __m128i scale = _mm_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1);
+    const __m128i mask = _mm_set1_epi16(0xFFF0);
+    size_t i = 0;
+    // 8 pixels from 12 bytes, but the load reads 16.
+    for (; i + 8 <= pixels && i / 2 * 3 + 16 <= inBytes; i += 8) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(in + i / 2 * 3));
+        v = _mm_mullo_epi16(_mm_shuffle_epi8(v, spread), scale);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_and_si128(v, mask));
+    }
+    unpackMono12pScalar(in + i / 2 * 3, inBytes - i / 2 * 3,
+                        out + i, pixels - i);
+    return pixels;
+}
+
+__attribute__((target("avx2")))
+static size_t unpackMono12pAVX2(const uint8_t* in, size_t inBytes,
+                                uint16_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes * 8 / 12);
+    const __m256i spread = _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5,
+                                            6, 7, 7, 8, 9, 10, 10, 11,
+                                            0, 1, 1, 2, 3, 4, 4, 5,
+                                            6, 7, 7, 8, 9, 10, 10, 11);
+    const __m256i scale = _mm256_setr_epi16(16, 1, 16, 1, 16, 1, 16, 1,
+                                            16, 1, 16, 1, 16, 1, 16, 1);
+    const __m256i mask = _mm256_set1_epi16(0xFFF0);
+    size_t i = 0;
+    // 16 pixels from 24 bytes, but the second load reads up to byte 28.
+    for (; i + 16 <= pixels && i / 2 * 3 + 28 <= inBytes; i += 16) {
+        const uint8_t* p = in + i / 2 * 3;
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+        v = _mm256_mullo_epi16(_mm256_shuffle_epi8(v, spread), scale);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            _mm256_and_si256(v, mask));
+    }
+    unpackMono12pSSSE3(in + i / 2 * 3, inBytes - i / 2 * 3,
+                       out + i, pixels - i);
+    return pixels;
+}
+
+__attribute__((target("ssse3")))
+static size_t expandYuv411SSSE3(const uint8_t* in, size_t inBytes,
+                                uint8_t* out, size_t pixels) {
+    pixels = std::min(pixels, inBytes / 6 * 4) / 4 * 4;
+    const __m128i spread = _mm_setr_epi8(0, 1, 3, 2, 0, 4, 3, 5,
+                                         6, 7, 9, 8, 6, 10, 9, 11);
+    size_t i = 0;
+    // 8 pixels from 12 bytes, but the load reads 16.
+    for (; i + 8 <= pixels && i / 2 * 3 + 16 <= inBytes; i += 8) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(in + i / 2 * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i),
+                         _mm_shuffle_epi8(v, spread));
+    }
+    expandYuv411Scalar(in + i / 2 * 3, inBytes - i / 2 * 3,
+                       out + 2 * i, pixels - i);
+    return pixels;
+}
+
+__attribute__((target("sse2")))
+static void shiftMono16SSE2(const uint16_t* in, uint16_t* out, size_t pixels,
+                            unsigned shift) {
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_sll_epi16(v, count));
+    }
+    shiftMono16Scalar(in + i, out + i, pixels - i, shift);
+}
+
+__attribute__((target("avx2")))
+static void shiftMono16AVX2(const uint16_t* in, uint16_t* out, size_t pixels,
+                            unsigned shift) {
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m256i v = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(in + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            _mm256_sll_epi16(v, count));
+    }
+    shiftMono16SSE2(in + i, out + i, pixels - i, shift);
+}
+
+// Adding 128 modulo 256 is the same as flipping the top bit.
+
+__attribute__((target("sse2")))
+static void offsetMono8SignedSSE2(const int8_t* in, uint8_t* out,
+                                  size_t pixels) {
+    const __m128i sign = _mm_set1_epi8(char(0x80));
+    size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_xor_si128(v, sign));
+    }
+    offsetMono8SignedScalar(in + i, out + i, pixels - i);
+}
+
+__attribute__((target("avx2")))
+static void offsetMono8SignedAVX2(const int8_t* in, uint8_t* out,
+                                  size_t pixels) {
+    const __m256i sign = _mm256_set1_epi8(char(0x80));
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32) {
+        __m256i v = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(in + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                            _mm256_xor_si256(v, sign));
+    }
+    offsetMono8SignedSSE2(in + i, out + i, pixels - i);
+}
+
+/*
+ * The 32-bit products are shifted back to 16 bits. SSE2 can only pack with
+ * signed saturation, so the values are moved to the signed range first and
+ * back afterwards.
+ */
+
+__attribute__((target("sse2")))
+static void correctFlatFieldSSE2(uint16_t* pixels, const uint16_t* dark,
+                                 const uint16_t* gain, size_t samples) {
+    const __m128i round = _mm_set1_epi32(1 << 13);
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    const __m128i sign = _mm_set1_epi16(short(0x8000));
+    size_t i = 0;
+    for (; i + 8 <= samples; i += 8) {
+        auto p = reinterpret_cast<__m128i*>(pixels + i);
+        __m128i d = _mm_subs_epu16(
+            _mm_loadu_si128(p),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(dark + i)));
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gain + i));
+        __m128i lo = _mm_mullo_epi16(d, g);
+        __m128i hi = _mm_mulhi_epu16(d, g);
+        __m128i a = _mm_unpacklo_epi16(lo, hi);
+        __m128i b = _mm_unpackhi_epi16(lo, hi);
+        a = _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(a, round), 14), bias);
+        b = _mm_sub_epi32(_mm_srli_epi32(_mm_add_epi32(b, round), 14), bias);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_packs_epi32(a, b), sign));
+    }
+    correctFlatFieldScalar(pixels + i, dark + i, gain + i, samples - i);
+}
+
+__attribute__((target("avx2")))
+static void correctFlatFieldAVX2(uint16_t* pixels, const uint16_t* dark,
+                                 const uint16_t* gain, size_t samples) {
+    const __m256i round = _mm256_set1_epi32(1 << 13);
+    size_t i = 0;
+    for (; i + 16 <= samples; i += 16) {
+        auto p = reinterpret_cast<__m256i*>(pixels + i);
+        __m256i d = _mm256_subs_epu16(
+            _mm256_loadu_si256(p),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dark + i)));
+        __m256i g = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(gain + i));
+        __m256i lo = _mm256_mullo_epi16(d, g);
+        __m256i hi = _mm256_mulhi_epu16(d, g);
+        // Unpacking and packing both work within lanes, so the order holds.
+        __m256i a = _mm256_unpacklo_epi16(lo, hi);
+        __m256i b = _mm256_unpackhi_epi16(lo, hi);
+        a = _mm256_srli_epi32(_mm256_add_epi32(a, round), 14);
+        b = _mm256_srli_epi32(_mm256_add_epi32(b, round), 14);
+        _mm256_storeu_si256(p, _mm256_packus_epi32(a, b));
+    }
+    correctFlatFieldSSE2(pixels + i, dark + i, gain + i, samples - i);
+}
+
+#endif
+
+namespace
+{
+
+enum class InstructionSet { Scalar, SSE2, SSSE3, AVX2 };
+
+InstructionSet detectInstructionSet() {
+#ifdef QARV_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return InstructionSet::AVX2;
+    if (__builtin_cpu_supports("ssse3"))
+        return InstructionSet::SSSE3;
+    if (__builtin_cpu_supports("sse2"))
+        return InstructionSet::SSE2;
+#endif
+    return InstructionSet::Scalar;
+}
+
+const InstructionSet supportedInstructionSet = detectInstructionSet();
+InstructionSet instructionSet = supportedInstructionSet;
+
+}
+
+size_t unpackMono12Packed(const uint8_t* in, size_t inBytes,
+                          uint16_t* out, size_t pixels) {
+    switch (instructionSet) {
+#ifdef QARV_X86_DISPATCH
+    case InstructionSet::AVX2:
+        return unpackMono12PackedAVX2(in, inBytes, out, pixels);
+
+    case InstructionSet::SSSE3:
+        return unpackMono12PackedSSSE3(in, inBytes, out, pixels);
+#endif
+    default:
+        return unpackMono12PackedScalar(in, inBytes, out, pixels);
+    }
+}
+
+size_t unpackMono10p(const uint8_t* in, size_t inBytes,
+                     uint16_t* out, size_t pixels) {
+    switch (instructionSet) {
+#ifdef QARV_X86_DISPATCH
+    case InstructionSet::AVX2:
+        return unpackMono10pAVX2(in, inBytes, out, pixels);
+
+    case InstructionSet::SSSE3:
+        return unpackMono10pSSSE3(in, inBytes, out, pixels);
+#endif
+    default:
+        return unpackMono10pScalar(in, inBytes, out, pixels);
+    }
+}
+
+size_t unpackMono12p(const uint8_t* in, size_t inBytes,
+                     uint16_t* out, size_t pixels) {
+    switch (instructionSet) {
+#ifdef QARV_X86_DISPATCH
+    case InstructionSet::AVX2:
+        return unpackMono12pAVX2(in, inBytes, out, pixels);
+
+    case InstructionSet::SSSE3:
+        return unpackMono12pSSSE3(in, inBytes, out, pixels);
+#endif
+    default:
+        return unpackMono12pScalar(in, inBytes, out, pixels);
+    }
+}
+
+void shiftMono16Scalar(const uint16_t* in, uint16_t* out, size_t pixels,
+                       unsigned shift) {
+    for (size_t i = 0; i < pixels; i++)
+        out[i] = in[i] << shift;
+}
+
+void shiftMono16(const uint16_t* in, uint16_t* out, size_t pixels,
+                 unsigned shift) {
+    switch (instructionSet) {
+#ifdef QARV_X86_DISPATCH
+    case InstructionSet::AVX2:
+        return shiftMono16AVX2(in, out, pixels, shift);
+
+    case InstructionSet::SSSE3:
+    case InstructionSet::SSE2:
+        return shiftMono16SSE2(in, out, pixels, shift);
+#endif
+    default:
+        return shiftMono16Scalar(in, out, pixels, shift);
+    }
+}
+
+void offsetMono8SignedScalar(const int8_t* in, uint8_t* out, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++)
+        out[i] = in[i] + 128;
+}
+
+void offsetMono8Signed(const int8_t* in, uint8_t* out, size_t pixels) {
+    switch (instructionSet) {
+#ifdef QARV_X86_DISPATCH
+    case InstructionSet::AVX2:
+        return offsetMono8SignedAVX2(in, out, pixels);
+
+    case InstructionSet::SSSE3:
+    case InstructionSet::SSE2:
+        return offsetMono8SignedSSE2(in, out, pixels);
+#endif
+    default:
+        return offsetMono8SignedScalar(in, out, pixels);
+    }
+}
+
+size_t expandYuv411(const uint8_t* in, size_t inBytes,
+                    uint8_t* out, size_t pixels) {
+    switch (instructionSet) {
+#ifdef QARV_X86_DISPATCH
+    case InstructionSet::AVX2:
+    case InstructionSet::SSSE3:
+        return expandYuv411SSSE3(in, inBytes, out, pixels);
+#endif
+    default:
+        return expandYuv411Scalar(in, inBytes, out, pixels);
+    }
+}
+
+void correctFlatFieldScalar(uint16_t* pixels, const uint16_t* dark,
+                            const uint16_t* gain, size_t samples) {
+    for (size_t i = 0; i < samples; i++) {
+        uint32_t d = pixels[i] > dark[i] ? pixels[i] - dark[i] : 0;
+        uint32_t v = (d * gain[i] + (1 << 13)) >> 14;
+        pixels[i] = std::min<uint32_t>(v, 65535);
+    }
+}
+
+void correctFlatField(uint16_t* pixels, const uint16_t* dark,
+                      const uint16_t* gain, size_t samples) {
+    switch (instructionSet) {
+#ifdef QARV_X86_DISPATCH
+    case InstructionSet::AVX2:
+        return correctFlatFieldAVX2(pixels, dark, gain, samples);
+
+    case InstructionSet::SSSE3:
+    case InstructionSet::SSE2:
+        return correctFlatFieldSSE2(pixels, dark, gain, samples);
+#endif
+    default:
+        return correctFlatFieldScalar(pixels, dark, gain, samples);
+    }
+}
+
+const char* unpackerInstructionSet() {
+    switch (instructionSet) {
+    case InstructionSet::AVX2:
+        return "AVX2";
+
+    case InstructionSet::SSSE3:
+        return "SSSE3";
+
+    case InstructionSet::SSE2:
+        return "SSE2";
+
+    default:
+        return "none";
+    }
+}
+
+bool setUnpackerInstructionSet(const char* name) {
+    const std::string n(name);
+    InstructionSet wanted = InstructionSet::Scalar;
+    if (n == "AVX2")
+        wanted = InstructionSet::AVX2;
+    else if (n == "SSSE3")
+        wanted = InstructionSet::SSSE3;
+    else if (n == "SSE2")
+        wanted = InstructionSet::SSE2;
+    if (wanted > supportedInstructionSet)
+        return false;
+    instructionSet = wanted;
+    return true;
+}
+
+}
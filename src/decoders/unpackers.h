@@ -0,0 +1,109 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Row kernels that unpack pixel data, mostly into 16-bit samples. Each has
+ * a plain C++ version, which serves as the reference, and on x86 vectorized
+ * versions that are chosen at runtime according to what the CPU supports.
+ * The input is always read strictly within the given number of bytes.
+ */
+
+#ifndef UNPACKERS_H
+#define UNPACKERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace QArv
+{
+
+/*
+ * GigE Vision Mono12Packed: two pixels in three bytes, the middle byte
+ * holding the low nibbles. Output samples are aligned to the most
+ * significant bit. Unpacks at most the given number of pixels, fewer if
+ * the input runs out; returns the number of pixels written.
+ */
+size_t unpackMono12Packed(const uint8_t* in, size_t inBytes,
+                          uint16_t* out, size_t pixels);
+size_t unpackMono12PackedScalar(const uint8_t* in, size_t inBytes,
+                                uint16_t* out, size_t pixels);
+
+/*
+ * GenICam PFNC Mono10p and Mono12p: pixels follow each other in a little-
+ * endian bit stream, four pixels in five bytes and two in three bytes,
+ * respectively. Output samples are aligned to the most significant bit.
+ * Otherwise, these behave like unpackMono12Packed().
+ */
+size_t unpackMono10p(const uint8_t* in, size_t inBytes,
+                     uint16_t* out, size_t pixels);
+size_t unpackMono10pScalar(const uint8_t* in, size_t inBytes,
+                           uint16_t* out, size_t pixels);
+size_t unpackMono12p(const uint8_t* in, size_t inBytes,
+                     uint16_t* out, size_t pixels);
+size_t unpackMono12pScalar(const uint8_t* in, size_t inBytes,
+                           uint16_t* out, size_t pixels);
+
+/*
+ * Unpacked formats with fewer significant bits than the sample size: shifts
+ * each sample left so that the data is aligned to the most significant bit.
+ */
+void shiftMono16(const uint16_t* in, uint16_t* out, size_t pixels,
+                 unsigned shift);
+void shiftMono16Scalar(const uint16_t* in, uint16_t* out, size_t pixels,
+                       unsigned shift);
+
+// Mono8Signed: moves the range to unsigned by adding 128 to each sample.
+void offsetMono8Signed(const int8_t* in, uint8_t* out, size_t pixels);
+void offsetMono8SignedScalar(const int8_t* in, uint8_t* out, size_t pixels);
+
+/*
+ * GigE Vision YUV411Packed (UYYVYY): repeats the chroma of each group of
+ * four pixels so that the output is YUV422 (UYVY), which OpenCV converts.
+ * The number of pixels is rounded down to whole groups; otherwise, this
+ * behaves like unpackMono12Packed().
+ */
+size_t expandYuv411(const uint8_t* in, size_t inBytes,
+                    uint8_t* out, size_t pixels);
+size_t expandYuv411Scalar(const uint8_t* in, size_t inBytes,
+                          uint8_t* out, size_t pixels);
+
+/*
+ * Flat-field correction of 16-bit samples, in place: subtracts the dark
+ * value, saturating at zero, and multiplies by the gain, which has 14
+ * fractional bits. The result is rounded and saturated.
+ */
+void correctFlatField(uint16_t* pixels, const uint16_t* dark,
+                      const uint16_t* gain, size_t samples);
+void correctFlatFieldScalar(uint16_t* pixels, const uint16_t* dark,
+                            const uint16_t* gain, size_t samples);
+
+// Name of the instruction set used by the dispatched kernels, for logging.
+const char* unpackerInstructionSet();
+
+/*
+ * Makes the dispatched kernels use the named instruction set, as returned by
+ * unpackerInstructionSet(), or the plain versions for any other name. For
+ * tests; must not be called while kernels run. Returns false, changing
+ * nothing, if the CPU does not support the instruction set.
+ */
+bool setUnpackerInstructionSet(const char* name);
+
+}
+
+#endif
@@ -0,0 +1,121 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filters/calibration.h"
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QTimer>
+#include <algorithm>
+
+using namespace QArv;
+
+FrameAverager::FrameAverager() : count(1) {
+    left.store(0);
+}
+
+void FrameAverager::start(int frames) {
+    QMutexLocker l(&lock);
+    count = std::max(frames, 1);
+    sum.release();
+    left.store(count, std::memory_order_relaxed);
+}
+
+int FrameAverager::remaining() {
+    return left.load(std::memory_order_relaxed);
+}
+
+cv::Mat FrameAverager::add(const cv::Mat& frame) {
+    QMutexLocker l(&lock);
+    if (left.load(std::memory_order_relaxed) == 0)
+        return cv::Mat();
+    const int type = CV_64FC(frame.channels());
+    if (sum.size() != frame.size() || sum.type() != type) {
+        // The frames changed, so averaging starts over.
+        sum = cv::Mat::zeros(frame.size(), type);
+        left.store(count, std::memory_order_relaxed);
+    }
+    cv::accumulate(frame, sum);
+    if (left.fetch_sub(1, std::memory_order_relaxed) > 1)
+        return cv::Mat();
+    cv::Mat mean = sum / count;
+    sum.release();
+    return mean;
+}
+
+CalibrationFilter::CalibrationFilter(ImageFilterPlugin* plugin,
+                                     const QString& group) :
+    ImageFilter(plugin), settingsGroup(group) {
+    frames.store(16);
+}
+
+QString CalibrationFilter::fileName() {
+    QMutexLocker l(&lock);
+    return currentFile;
+}
+
+void CalibrationFilter::restoreSettings() {
+    QSettings settings;
+    frames.store(settings.value(settingsGroup + "/frames", 16).toInt(),
+                 std::memory_order_relaxed);
+    auto name = settings.value(settingsGroup + "/file").toString();
+    if (!name.isEmpty() && name != fileName())
+        load(name);
+}
+
+void CalibrationFilter::saveSettings() {
+    QSettings settings;
+    settings.setValue(settingsGroup + "/frames",
+                      frames.load(std::memory_order_relaxed));
+    auto name = fileName();
+    if (!name.isEmpty())
+        settings.setValue(settingsGroup + "/file", name);
+}
+
+CalibrationSettingsWidget::CalibrationSettingsWidget(CalibrationFilter* filter,
+                                                     QWidget* parent) :
+    ImageFilterSettingsWidget(filter, parent) {
+    auto timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), SLOT(updateStatus()));
+    timer->start(200);
+}
+
+void CalibrationSettingsWidget::on_loadButton_clicked(bool checked) {
+    auto name = QFileDialog::getOpenFileName(this, tr("Open file"),
+                                             filter()->fileName());
+    if (!name.isEmpty() && filter()->load(name))
+        filter()->saveSettings();
+    updateStatus();
+}
+
+void CalibrationSettingsWidget::on_saveButton_clicked(bool checked) {
+    auto name = QFileDialog::getSaveFileName(this, tr("Save file"),
+                                             filter()->fileName());
+    if (!name.isEmpty() && filter()->save(name))
+        filter()->saveSettings();
+    updateStatus();
+}
+
+QString CalibrationSettingsWidget::fileStatus() {
+    auto name = filter()->fileName();
+    return name.isEmpty() ? tr("not saved") : QFileInfo(name).fileName();
+}
+
+CalibrationFilter* CalibrationSettingsWidget::filter() {
+    return static_cast<CalibrationFilter*>(imageFilter);
+}
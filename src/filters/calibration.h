@@ -0,0 +1,125 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Common parts of the filters that calibrate themselves from the frames that
+ * pass through them, and keep the calibration in a file: averaging of the
+ * frames, the file name and the settings, and a settings widget with load
+ * and save buttons.
+ */
+
+#ifndef CALIBRATION_H
+#define CALIBRATION_H
+
+#include "filters/filter.h"
+#include <QMutex>
+#include <atomic>
+
+namespace QArv
+{
+
+/*
+ * Averages a number of frames in double precision. Frames are added by the
+ * worker threads, possibly concurrently.
+ */
+class FrameAverager {
+public:
+    FrameAverager();
+
+    //! Averages the given number of frames, dropping a partial average.
+    void start(int frames);
+
+    //! Frames left to average, or 0 when not averaging.
+    int remaining();
+
+    /*!
+     * Adds the frame if averaging. After the last frame, returns the
+     * average, CV_64F with the channels of the frames; otherwise returns an
+     * empty matrix. If the size or type of the frames changes, averaging
+     * starts over.
+     */
+    cv::Mat add(const cv::Mat& frame);
+
+private:
+    QMutex lock;
+    std::atomic<int> left;
+    int count;
+    cv::Mat sum;
+};
+
+class CalibrationFilter : public ImageFilter {
+public:
+    /*!
+     * The settings group holds the number of frames to average and the
+     * name of the calibration file.
+     */
+    CalibrationFilter(ImageFilterPlugin* plugin, const QString& group);
+    void restoreSettings() override;
+    void saveSettings() override;
+    bool wantsFrames() override { return averager.remaining() > 0; }
+
+    //! Reads the calibration from a file. Returns false if it cannot be used.
+    virtual bool load(QString fileName) = 0;
+
+    virtual bool save(QString fileName) = 0;
+
+    QString fileName();
+
+protected:
+    // Guards the calibration and the file name.
+    QMutex lock;
+    QString currentFile;
+    FrameAverager averager;
+
+    // Frames to average, as set in the settings.
+    std::atomic<int> frames;
+
+    const QString settingsGroup;
+};
+
+/*
+ * Handles the loadButton and saveButton of a calibration filter's user
+ * interface, and polls the status, since the calibration happens in the
+ * worker threads.
+ */
+class CalibrationSettingsWidget : public ImageFilterSettingsWidget {
+    Q_OBJECT
+
+public:
+    CalibrationSettingsWidget(CalibrationFilter* filter,
+                              QWidget* parent = 0);
+
+protected slots:
+    //! Called periodically and after loading or saving.
+    virtual void updateStatus() = 0;
+
+    void on_loadButton_clicked(bool checked);
+    void on_saveButton_clicked(bool checked);
+
+protected:
+    //! The name of the calibration file for the status, or "not saved".
+    QString fileStatus();
+
+private:
+    CalibrationFilter* filter();
+};
+
+}
+
+#endif
@@ -0,0 +1,317 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "globals.h"
+#include "filters/defectivepixels.h"
+#include <QFile>
+#include <QTextStream>
+#include <QtPlugin>
+
+using namespace QArv;
+
+namespace
+{
+
+template <typename T, typename Corrections>
+void correctPixels(cv::Mat& image, const Corrections& corrections) {
+    const int channels = image.channels();
+    for (const auto& c : corrections) {
+        T* pixel = image.ptr<T>(c.pixel.y()) + c.pixel.x() * channels;
+        for (int ch = 0; ch < channels; ch++) {
+            double sum = 0;
+            for (int i = 0; i < c.count; i++) {
+                const QPoint& n = c.neighbours[i];
+                sum += image.ptr<T>(n.y())[n.x() * channels + ch];
+            }
+            pixel[ch] = cv::saturate_cast<T>(sum / c.count);
+        }
+    }
+}
+
+}
+
+QString DefectivePixelsPlugin::name() {
+    return tr("Defective pixels");
+}
+
+ImageFilter* DefectivePixelsPlugin::makeFilter() {
+    return new DefectivePixelsFilter(this);
+}
+
+DefectivePixelsFilter::DefectivePixelsFilter(ImageFilterPlugin* plugin) :
+    CalibrationFilter(plugin, "qarv_filters_defects") {
+    threshold.store(0.1);
+}
+
+void DefectivePixelsFilter::filterImage(cv::Mat& image) {
+    if (averager.remaining() > 0)
+        accumulate(image);
+    auto p = plan(image.size());
+    if (!p)
+        return;
+    switch (image.depth()) {
+    case CV_8U:
+        correctPixels<uchar>(image, p->corrections);
+        break;
+
+    case CV_16U:
+        correctPixels<ushort>(image, p->corrections);
+        break;
+
+    case CV_32F:
+        correctPixels<float>(image, p->corrections);
+        break;
+    }
+}
+
+/*
+ * Each defect is interpolated from its direct neighbours, or from the
+ * diagonal ones if all of those are defective or outside the image.
+ * Defects outside the image are ignored.
+ */
+QSharedPointer<const DefectivePixelsFilter::Plan>
+DefectivePixelsFilter::plan(cv::Size size) {
+    QMutexLocker l(&lock);
+    if (!current || current->isEmpty())
+        return QSharedPointer<const Plan>();
+    if (currentPlan && currentPlan->defects == current
+        && currentPlan->size == size)
+        return currentPlan;
+    const cv::Rect bounds(cv::Point(), size);
+    auto inside = [&] (const QPoint& p) {
+        return bounds.contains(cv::Point(p.x(), p.y()));
+    };
+    cv::Mat defective = cv::Mat::zeros(size, CV_8U);
+    for (const auto& pixel : *current)
+        if (inside(pixel))
+            defective.at<uchar>(pixel.y(), pixel.x()) = 1;
+    const QPoint direct[] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    const QPoint diagonal[] = { { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 } };
+    auto p = new Plan { current, size, {} };
+    for (const auto& pixel : *current) {
+        if (!inside(pixel))
+            continue;
+        Correction c;
+        c.pixel = pixel;
+        c.count = 0;
+        for (const QPoint* offsets : { direct, diagonal }) {
+            for (int i = 0; i < 4; i++) {
+                const QPoint n = pixel + offsets[i];
+                if (inside(n) && !defective.at<uchar>(n.y(), n.x()))
+                    c.neighbours[c.count++] = n;
+            }
+            if (c.count > 0)
+                break;
+        }
+        if (c.count > 0)
+            p->corrections << c;
+    }
+    currentPlan = QSharedPointer<const Plan>(p);
+    return currentPlan;
+}
+
+QSharedPointer<const DefectivePixelsFilter::Defects>
+DefectivePixelsFilter::defects() {
+    QMutexLocker l(&lock);
+    return current;
+}
+
+void DefectivePixelsFilter::setDefects(const Defects& defects) {
+    QMutexLocker l(&lock);
+    current = QSharedPointer<const Defects>(new Defects(defects));
+    currentFile = QString();
+}
+
+void DefectivePixelsFilter::detect(int count, double limit) {
+    QMutexLocker l(&lock);
+    detectThreshold = limit;
+    averager.start(count);
+}
+
+void DefectivePixelsFilter::accumulate(const cv::Mat& image) {
+    const int depth = image.depth();
+    if (depth != CV_8U && depth != CV_16U && depth != CV_32F)
+        return;
+    // Held while adding, so that the threshold belongs to the average.
+    QMutexLocker l(&lock);
+    const cv::Mat average = averager.add(image);
+    if (average.empty())
+        return;
+
+    cv::Mat mean, median, difference;
+    average.convertTo(mean, image.type());
+    cv::medianBlur(mean, median, 3);
+    cv::absdiff(mean, median, difference);
+    difference.convertTo(difference, CV_64F);
+    const double fullRange = depth == CV_8U ? 255 :
+                             depth == CV_16U ? 65535 : 1;
+    const double limit = detectThreshold * fullRange;
+    const int channels = image.channels();
+    auto found = new Defects;
+    for (int y = 0; y < difference.rows; y++) {
+        const double* d = difference.ptr<double>(y);
+        for (int x = 0; x < difference.cols; x++) {
+            for (int ch = 0; ch < channels; ch++) {
+                if (d[x * channels + ch] > limit) {
+                    *found << QPoint(x, y);
+                    break;
+                }
+            }
+        }
+    }
+    current = QSharedPointer<const Defects>(found);
+    currentFile = QString();
+}
+
+bool DefectivePixelsFilter::load(QString fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        logMessage() << "Unable to open defective pixel list" << fileName;
+        return false;
+    }
+    QTextStream stream(&file);
+    Defects loaded;
+    for (int line = 1; !stream.atEnd(); line++) {
+        auto text = stream.readLine();
+        const int comment = text.indexOf('#');
+        if (comment >= 0)
+            text.truncate(comment);
+        auto fields = text.simplified().split(' ', QString::SkipEmptyParts);
+        if (fields.isEmpty())
+            continue;
+        bool okx = false, oky = false;
+        QPoint pixel;
+        if (fields.size() == 2) {
+            pixel.setX(fields[0].toInt(&okx));
+            pixel.setY(fields[1].toInt(&oky));
+        }
+        if (!okx || !oky || pixel.x() < 0 || pixel.y() < 0) {
+            logMessage() << "Invalid defective pixel list" << fileName
+                         << "at line" << line;
+            return false;
+        }
+        loaded << pixel;
+    }
+    QMutexLocker l(&lock);
+    current = QSharedPointer<const Defects>(new Defects(loaded));
+    currentFile = fileName;
+    return true;
+}
+
+bool DefectivePixelsFilter::save(QString fileName) {
+    auto list = defects();
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        logMessage() << "Unable to write defective pixel list" << fileName;
+        return false;
+    }
+    QTextStream stream(&file);
+    stream << "# x y\n";
+    if (list)
+        for (const auto& pixel : *list)
+            stream << pixel.x() << " " << pixel.y() << "\n";
+    stream.flush();
+    if (file.error() != QFile::NoError) {
+        logMessage() << "Unable to write defective pixel list" << fileName;
+        return false;
+    }
+    QMutexLocker l(&lock);
+    currentFile = fileName;
+    return true;
+}
+
+void DefectivePixelsFilter::restoreSettings() {
+    CalibrationFilter::restoreSettings();
+    QSettings settings;
+    threshold.store(settings.value(settingsGroup + "/threshold",
+                                   0.1).toDouble(),
+                    std::memory_order_relaxed);
+}
+
+void DefectivePixelsFilter::saveSettings() {
+    CalibrationFilter::saveSettings();
+    QSettings settings;
+    settings.setValue(settingsGroup + "/threshold",
+                      threshold.load(std::memory_order_relaxed));
+}
+
+ImageFilterSettingsWidget* DefectivePixelsFilter::createSettingsWidget() {
+    return new DefectivePixelsSettingsWidget(this);
+}
+
+DefectivePixelsSettingsWidget::DefectivePixelsSettingsWidget(
+    ImageFilter* filter_, QWidget* parent) :
+    CalibrationSettingsWidget(static_cast<DefectivePixelsFilter*>(filter_),
+                              parent) {
+    // This also connects the load and save buttons.
+    setupUi(this);
+    framesSpinbox->setValue(filter()->frames.load(std::memory_order_relaxed));
+    thresholdSpinbox->setValue(
+        filter()->threshold.load(std::memory_order_relaxed));
+    updateStatus();
+}
+
+void DefectivePixelsSettingsWidget::applySettings() {
+    filter()->frames.store(framesSpinbox->value(), std::memory_order_relaxed);
+    filter()->threshold.store(thresholdSpinbox->value(),
+                              std::memory_order_relaxed);
+}
+
+void DefectivePixelsSettingsWidget::setLiveUpdate(bool enabled) {
+    if (enabled) {
+        connect(framesSpinbox, SIGNAL(valueChanged(int)),
+                SLOT(applySettings()));
+        connect(thresholdSpinbox, SIGNAL(valueChanged(double)),
+                SLOT(applySettings()));
+    } else {
+        disconnect(framesSpinbox, SIGNAL(valueChanged(int)), this,
+                   SLOT(applySettings()));
+        disconnect(thresholdSpinbox, SIGNAL(valueChanged(double)), this,
+                   SLOT(applySettings()));
+    }
+}
+
+void DefectivePixelsSettingsWidget::on_detectButton_clicked(bool checked) {
+    filter()->detect(framesSpinbox->value(), thresholdSpinbox->value());
+    updateStatus();
+}
+
+void DefectivePixelsSettingsWidget::on_clearButton_clicked(bool checked) {
+    filter()->setDefects(DefectivePixelsFilter::Defects());
+    updateStatus();
+}
+
+void DefectivePixelsSettingsWidget::updateStatus() {
+    const int remaining = filter()->detectRemaining();
+    const auto list = filter()->defects();
+    detectButton->setEnabled(remaining == 0);
+    if (remaining > 0) {
+        statusLabel->setText(tr("Detecting, %1 frames left.").arg(remaining));
+    } else {
+        statusLabel->setText(tr("%1 defective pixels, %2.")
+                             .arg(list.isNull() ? 0 : list->size())
+                             .arg(fileStatus()));
+    }
+}
+
+DefectivePixelsFilter* DefectivePixelsSettingsWidget::filter() {
+    return static_cast<DefectivePixelsFilter*>(imageFilter);
+}
+
+Q_IMPORT_PLUGIN(DefectivePixelsPlugin)
@@ -0,0 +1,135 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEFECTIVEPIXELS_H
+#define DEFECTIVEPIXELS_H
+
+#include "filters/calibration.h"
+#include "ui_defectivepixels.h"
+#include <QPoint>
+#include <QSharedPointer>
+#include <QVector>
+#include <atomic>
+
+namespace QArv
+{
+
+/*
+ * Replaces hot and dead pixels with the average of their good neighbours.
+ * Only the listed pixels are touched, so the cost depends on the number of
+ * defects rather than on the size of the image. The list is detected from
+ * the frames that pass through the filter, or loaded from a text file with
+ * one "x y" pair per line. The coordinates are sensor coordinates, so the
+ * filter works in sensor space.
+ */
+class DefectivePixelsFilter : public CalibrationFilter {
+public:
+    DefectivePixelsFilter(ImageFilterPlugin* plugin);
+    ImageFilterSettingsWidget* createSettingsWidget() override;
+    void restoreSettings() override;
+    void saveSettings() override;
+    void filterImage(cv::Mat& image) override;
+    bool isSensorSpace() override { return true; }
+
+    typedef QVector<QPoint> Defects;
+
+    QSharedPointer<const Defects> defects();
+    void setDefects(const Defects& defects);
+
+    /*!
+     * Averages the next frames and marks the pixels that differ from the
+     * median of their neighbourhood by more than the threshold, relative to
+     * the full range of the image type. This finds pixels that clip in a
+     * dark frame and pixels that stay dark in a bright one.
+     */
+    void detect(int count, double limit);
+
+    //! Frames left to detect from, or 0 when not detecting.
+    int detectRemaining() { return averager.remaining(); }
+
+    //! Reads a defect list. Returns false if it cannot be used.
+    bool load(QString fileName) override;
+
+    bool save(QString fileName) override;
+
+private:
+    // A defective pixel and the neighbours it is interpolated from.
+    struct Correction {
+        QPoint pixel;
+        QPoint neighbours[4];
+        int count;
+    };
+
+    // The corrections for the current list and an image of a given size.
+    struct Plan {
+        QSharedPointer<const Defects> defects;
+        cv::Size size;
+        QVector<Correction> corrections;
+    };
+
+    QSharedPointer<const Plan> plan(cv::Size size);
+    void accumulate(const cv::Mat& image);
+
+    QSharedPointer<const Defects> current;
+    QSharedPointer<const Plan> currentPlan;
+
+    // Detection in progress, guarded by the lock.
+    double detectThreshold;
+
+    // Detection threshold, as set in the settings.
+    std::atomic<double> threshold;
+
+    friend class DefectivePixelsSettingsWidget;
+};
+
+class DefectivePixelsPlugin : public QObject, public ImageFilterPlugin {
+    Q_OBJECT
+    Q_INTERFACES(QArv::ImageFilterPlugin)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.DefectivePixelsFilter")
+
+public:
+    QString name() override;
+    ImageFilter* makeFilter() override;
+};
+
+class DefectivePixelsSettingsWidget : public CalibrationSettingsWidget,
+                                      private Ui_defectivePixelsSettingsWidget {
+    Q_OBJECT
+
+public:
+    DefectivePixelsSettingsWidget(ImageFilter* filter,
+                                  QWidget* parent = 0);
+
+protected slots:
+    void setLiveUpdate(bool enabled) override;
+    void applySettings() override;
+
+    void updateStatus() override;
+
+private slots:
+    void on_detectButton_clicked(bool checked);
+    void on_clearButton_clicked(bool checked);
+
+private:
+    DefectivePixelsFilter* filter();
+};
+
+};
+
+#endif
@@ -18,6 +18,7 @@
  */
 
 #include "filters/filter.h"
+#include "decoders/parallelstrips.h"
 #include <QPluginLoader>
 #include <QHBoxLayout>
 #include <QCheckBox>
@@ -38,6 +39,64 @@ ImageFilterPlugin* ImageFilter::plugin() {
     return pluginPtr;
 }
 
+void ImageFilter::filterChain(const QVector<ImageFilterPtr>& chain,
+                              cv::Mat& image, bool sensorSpace) {
+    // Point operations are collected until some other filter comes along,
+    // then their transfer functions are composed into one table.
+    QVector<ImageFilter*> points;
+    auto applyPoints = [&] () {
+        if (points.size() == 1) {
+            points[0]->filterImage(image);
+        } else if (!points.isEmpty()) {
+            const int depth = image.depth();
+            cv::Mat table(1, depth == CV_8U ? 256 : 65536, depth);
+            for (int i = 0; i < table.cols; i++) {
+                if (depth == CV_8U)
+                    table.at<uchar>(i) = i;
+                else
+                    table.at<ushort>(i) = i;
+            }
+            for (auto filter : points) {
+                filter->transfer(table);
+                if (table.depth() != depth)
+                    table.convertTo(table, depth);
+            }
+            applyTable(image, table);
+        }
+        points.clear();
+    };
+    for (auto filter : chain) {
+        if (!filter->isEnabled() || filter->isSensorSpace() != sensorSpace)
+            continue;
+        const int depth = image.depth();
+        if (filter->isPointOperation() && (depth == CV_8U || depth == CV_16U)) {
+            points << filter.data();
+        } else {
+            applyPoints();
+            filter->filterImage(image);
+        }
+    }
+    applyPoints();
+}
+
+void ImageFilter::applyTable(cv::Mat& image, const cv::Mat& table) {
+    const int cols = image.cols * image.channels();
+    forEachStrip(image.rows, cols, 1, [&] (int begin, int end) {
+        if (image.depth() == CV_8U) {
+            cv::Mat rows = image.rowRange(begin, end);
+            cv::LUT(rows, table, rows);
+            return;
+        }
+        // cv::LUT() only takes 8-bit images.
+        const ushort* lut = table.ptr<ushort>();
+        for (int y = begin; y < end; y++) {
+            ushort* line = image.ptr<ushort>(y);
+            for (int x = 0; x < cols; x++)
+                line[x] = lut[line[x]];
+        }
+    });
+}
+
 ImageFilter* ImageFilterPlugin::makeFilter(QString name) {
     auto plugins = QPluginLoader::staticInstances();
     foreach (auto plugin, plugins) {
@@ -23,6 +23,8 @@
  * written with this in mind, especially the live updates!
  * It may not matter, however: e.g. the Levels plugin does not really care
  * about partial parameter updates.
+ * When frames are processed by several workers, filterImage() is called
+ * concurrently on the same filter instance, so it must be reentrant.
  */
 
 #ifndef FILTER_H
@@ -83,6 +85,49 @@ public:
     //! The gist of the matter. It works in-place. It can return a float CV_TYPE!
     virtual void filterImage(cv::Mat& image) = 0;
 
+    /*!
+     * Returns true if filterImage() maps each value on its own, the same way
+     * for every pixel and channel, and keeps 8 and 16-bit images at their
+     * depth. Such filters are merged into a single lookup table when they
+     * follow each other in the chain.
+     */
+    virtual bool isPointOperation() { return false; }
+
+    /*!
+     * Maps the values of an 8 or 16-bit row in place, giving the transfer
+     * function of a point operation. The default implementation filters the
+     * row as an image.
+     */
+    virtual void transfer(cv::Mat& values) { filterImage(values); }
+
+    /*!
+     * Returns true if the filter works in sensor coordinates, e.g. with
+     * calibration data captured from the camera. Such filters get the
+     * decoded image before it is inverted, flipped or rotated, and before
+     * the other filters.
+     */
+    virtual bool isSensorSpace() { return false; }
+
+    /*!
+     * Returns true if the filter must see full frames even when nothing
+     * else needs them decoded, e.g. while it captures a calibration.
+     */
+    virtual bool wantsFrames() { return false; }
+
+    /*!
+     * Runs the enabled filters of the chain whose isSensorSpace() is as
+     * given on the image. Consecutive point operations on an 8 or 16-bit
+     * image are applied in a single pass.
+     */
+    static void filterChain(const QVector<ImageFilterPtr>& chain,
+                            cv::Mat& image, bool sensorSpace = false);
+
+    /*!
+     * Maps each value of an 8 or 16-bit image through a single-row table of
+     * the same depth, with 256 or 65536 entries.
+     */
+    static void applyTable(cv::Mat& image, const cv::Mat& table);
+
     //! Used by the main window to mark filter as enabled.
     bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
     void setEnabled(bool enable) {
@@ -0,0 +1,298 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "globals.h"
+#include "filters/flatfield.h"
+#include "decoders/parallelstrips.h"
+#include "decoders/unpackers.h"
+#include <QSaveFile>
+#include <QtPlugin>
+#include <cstring>
+
+using namespace QArv;
+
+namespace
+{
+
+/*
+ * A calibration file holds this header, followed by the dark map and the
+ * gain map, each with rows * cols * channels samples in native byte order.
+ * The header size keeps the maps aligned.
+ */
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 rows, cols, channels;
+    quint32 reserved[2];
+};
+
+const char fileMagic[8] = { 'Q', 'A', 'R', 'V', 'F', 'L', 'A', 'T' };
+const quint32 fileVersion = 1;
+
+// Gain of 1 in the fixed point format used by correctFlatField().
+const int unitGain = 1 << 14;
+
+// The gain map that evens out the flat frame and keeps its mean level.
+cv::Mat gainMap(const cv::Mat& flat, const cv::Mat& dark) {
+    const int type = CV_64FC(flat.channels());
+    cv::Mat signal, darkSignal;
+    flat.convertTo(signal, type);
+    dark.convertTo(darkSignal, type);
+    signal -= darkSignal;
+    const cv::Scalar level = cv::mean(signal);
+    const int channels = flat.channels();
+    const int samples = flat.cols * channels;
+    cv::Mat gain(flat.size(), type);
+    for (int y = 0; y < flat.rows; y++) {
+        const double* s = signal.ptr<double>(y);
+        double* g = gain.ptr<double>(y);
+        // Samples without signal cannot be corrected and are left be.
+        for (int x = 0; x < samples; x++)
+            g[x] = s[x] > 0 ? unitGain * level[x % channels] / s[x]
+                            : unitGain;
+    }
+    // Gains that do not fit the fixed point format saturate.
+    cv::Mat result;
+    gain.convertTo(result, flat.type());
+    return result;
+}
+
+}
+
+QString FlatFieldPlugin::name() {
+    return tr("Flat field");
+}
+
+ImageFilter* FlatFieldPlugin::makeFilter() {
+    return new FlatFieldFilter(this);
+}
+
+FlatFieldFilter::FlatFieldFilter(ImageFilterPlugin* plugin) :
+    CalibrationFilter(plugin, "qarv_filters_flatfield") {
+    mismatch.store(false);
+}
+
+void FlatFieldFilter::filterImage(cv::Mat& image) {
+    if (averager.remaining() > 0)
+        accumulate(image);
+    auto c = calibration();
+    if (!c)
+        return;
+    if (image.depth() != CV_16U || image.type() != c->dark.type()
+        || image.size() != c->dark.size()) {
+        mismatch.store(true, std::memory_order_relaxed);
+        return;
+    }
+    mismatch.store(false, std::memory_order_relaxed);
+    const int samples = image.cols * image.channels();
+    forEachStrip(image.rows, samples, 1, [&] (int begin, int end) {
+        for (int y = begin; y < end; y++)
+            correctFlatField(image.ptr<uint16_t>(y),
+                             c->dark.ptr<uint16_t>(y),
+                             c->gain.ptr<uint16_t>(y), samples);
+    });
+}
+
+void FlatFieldFilter::capture(CaptureKind kind, int count) {
+    QMutexLocker l(&lock);
+    captureKind = kind;
+    averager.start(count);
+}
+
+bool FlatFieldFilter::mismatched() {
+    return mismatch.load(std::memory_order_relaxed);
+}
+
+QSharedPointer<const FlatFieldFilter::Calibration>
+FlatFieldFilter::calibration() {
+    QMutexLocker l(&lock);
+    return current;
+}
+
+/*
+ * When enough frames have been averaged, the average becomes the new dark
+ * map, or the flat frame from which the gain map is computed. The other map
+ * is kept if it matches the frames. A flat frame captured before the dark
+ * map is kept too, and the gain is computed again when the dark map changes.
+ */
+void FlatFieldFilter::accumulate(const cv::Mat& image) {
+    if (image.depth() != CV_16U)
+        return;
+    // Held while adding, so that the kind cannot change under the average.
+    QMutexLocker l(&lock);
+    const cv::Mat mean = averager.add(image);
+    if (mean.empty())
+        return;
+    auto c = new Calibration;
+    const bool matches = current && current->dark.type() == image.type()
+                         && current->dark.size() == image.size();
+    if (captureKind == Dark) {
+        mean.convertTo(c->dark, image.type());
+        if (matches && !current->flat.empty()) {
+            c->flat = current->flat;
+            c->gain = gainMap(c->flat, c->dark);
+        } else if (matches) {
+            c->gain = current->gain;
+            c->file = current->file;
+        } else {
+            c->gain = cv::Mat(image.size(), image.type(),
+                              cv::Scalar::all(unitGain));
+        }
+    } else {
+        if (matches) {
+            c->dark = current->dark;
+            c->file = current->file;
+        } else {
+            c->dark = cv::Mat::zeros(image.size(), image.type());
+        }
+        mean.convertTo(c->flat, image.type());
+        c->gain = gainMap(c->flat, c->dark);
+    }
+    current = QSharedPointer<const Calibration>(c);
+    currentFile = QString();
+}
+
+bool FlatFieldFilter::load(QString fileName) {
+    auto file = QSharedPointer<QFile>::create(fileName);
+    if (!file->open(QIODevice::ReadOnly)) {
+        logMessage() << "Unable to open flat-field calibration" << fileName;
+        return false;
+    }
+    FileHeader header;
+    const qint64 size = file->size();
+    uchar* data = NULL;
+    if (size >= qint64(sizeof(header)))
+        data = file->map(0, size);
+    if (data != NULL)
+        memcpy(&header, data, sizeof(header));
+    const qint64 samples = data == NULL ? 0 :
+        qint64(header.rows) * header.cols * header.channels;
+    if (data == NULL || memcmp(header.magic, fileMagic, sizeof(fileMagic))
+        || header.version != fileVersion || header.channels == 0
+        || header.channels > CV_CN_MAX
+        || qint64(sizeof(header)) + 2 * samples * 2 != size) {
+        logMessage() << "Invalid flat-field calibration" << fileName;
+        return false;
+    }
+    auto c = new Calibration;
+    const int type = CV_16UC(header.channels);
+    c->dark = cv::Mat(header.rows, header.cols, type, data + sizeof(header));
+    c->gain = cv::Mat(header.rows, header.cols, type,
+                      data + sizeof(header) + samples * 2);
+    c->file = file;
+    QMutexLocker l(&lock);
+    current = QSharedPointer<const Calibration>(c);
+    currentFile = fileName;
+    return true;
+}
+
+bool FlatFieldFilter::save(QString fileName) {
+    auto c = calibration();
+    if (!c)
+        return false;
+    // The file is written aside and renamed over the old one, so that
+    // a calibration mapped from it stays valid.
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        logMessage() << "Unable to write flat-field calibration" << fileName;
+        return false;
+    }
+    FileHeader header = {};
+    memcpy(header.magic, fileMagic, sizeof(fileMagic));
+    header.version = fileVersion;
+    header.rows = c->dark.rows;
+    header.cols = c->dark.cols;
+    header.channels = c->dark.channels();
+    bool ok = file.write(reinterpret_cast<const char*>(&header),
+                         sizeof(header)) == sizeof(header);
+    const qint64 lineBytes = c->dark.cols * c->dark.elemSize();
+    for (const cv::Mat* map : { &c->dark, &c->gain })
+        for (int y = 0; ok && y < map->rows; y++)
+            ok = file.write(reinterpret_cast<const char*>(map->ptr(y)),
+                            lineBytes) == lineBytes;
+    if (!ok || !file.commit()) {
+        logMessage() << "Unable to write flat-field calibration" << fileName;
+        return false;
+    }
+    QMutexLocker l(&lock);
+    currentFile = fileName;
+    return true;
+}
+
+ImageFilterSettingsWidget* FlatFieldFilter::createSettingsWidget() {
+    return new FlatFieldSettingsWidget(this);
+}
+
+FlatFieldSettingsWidget::FlatFieldSettingsWidget(ImageFilter* filter_,
+                                                 QWidget* parent) :
+    CalibrationSettingsWidget(static_cast<FlatFieldFilter*>(filter_),
+                              parent) {
+    // This also connects the load and save buttons.
+    setupUi(this);
+    framesSpinbox->setValue(filter()->frames.load(std::memory_order_relaxed));
+    updateStatus();
+}
+
+void FlatFieldSettingsWidget::applySettings() {
+    filter()->frames.store(framesSpinbox->value(), std::memory_order_relaxed);
+}
+
+void FlatFieldSettingsWidget::setLiveUpdate(bool enabled) {
+    if (enabled)
+        connect(framesSpinbox, SIGNAL(valueChanged(int)),
+                SLOT(applySettings()));
+    else
+        disconnect(framesSpinbox, SIGNAL(valueChanged(int)), this,
+                   SLOT(applySettings()));
+}
+
+void FlatFieldSettingsWidget::on_darkButton_clicked(bool checked) {
+    filter()->capture(FlatFieldFilter::Dark, framesSpinbox->value());
+    updateStatus();
+}
+
+void FlatFieldSettingsWidget::on_flatButton_clicked(bool checked) {
+    filter()->capture(FlatFieldFilter::Flat, framesSpinbox->value());
+    updateStatus();
+}
+
+void FlatFieldSettingsWidget::updateStatus() {
+    const int remaining = filter()->captureRemaining();
+    const auto c = filter()->calibration();
+    darkButton->setEnabled(remaining == 0);
+    flatButton->setEnabled(remaining == 0);
+    saveButton->setEnabled(remaining == 0 && !c.isNull());
+    if (remaining > 0) {
+        statusLabel->setText(tr("Capturing, %1 frames left.").arg(remaining));
+    } else if (!c) {
+        statusLabel->setText(tr("Not calibrated."));
+    } else if (filter()->mismatched()) {
+        statusLabel->setText(tr("The calibration does not match the image."));
+    } else {
+        statusLabel->setText(tr("Calibrated for %1x%2, %3.")
+                             .arg(c->dark.cols).arg(c->dark.rows)
+                             .arg(fileStatus()));
+    }
+}
+
+FlatFieldFilter* FlatFieldSettingsWidget::filter() {
+    return static_cast<FlatFieldFilter*>(imageFilter);
+}
+
+Q_IMPORT_PLUGIN(FlatFieldPlugin)
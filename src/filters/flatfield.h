@@ -0,0 +1,123 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLATFIELD_H
+#define FLATFIELD_H
+
+#include "filters/calibration.h"
+#include "ui_flatfield.h"
+#include <QFile>
+#include <QSharedPointer>
+#include <atomic>
+
+namespace QArv
+{
+
+/*
+ * Dark-frame subtraction and flat-field correction of 16-bit images. The
+ * calibration is captured from the frames that pass through the filter,
+ * which works in sensor space, so the frames are not yet transformed. Each
+ * sample becomes (value - dark) * gain, with the gain in fixed point, see
+ * correctFlatField().
+ */
+class FlatFieldFilter : public CalibrationFilter {
+public:
+    FlatFieldFilter(ImageFilterPlugin* plugin);
+    ImageFilterSettingsWidget* createSettingsWidget() override;
+    void filterImage(cv::Mat& image) override;
+    bool isSensorSpace() override { return true; }
+
+    //! The maps, CV_16U with the size and channels of the image.
+    struct Calibration {
+        cv::Mat dark, gain;
+        // The averaged flat frame, so that the gain follows a new dark map.
+        // Empty if the flat frame was not captured.
+        cv::Mat flat;
+        // Set when the maps refer to a mapped calibration file.
+        QSharedPointer<QFile> file;
+    };
+
+    enum CaptureKind { Dark, Flat };
+
+    //! Averages the next frames into the dark or flat map.
+    void capture(CaptureKind kind, int count);
+
+    //! Frames left to capture, or 0 when not capturing.
+    int captureRemaining() { return averager.remaining(); }
+
+    /*!
+     * True if the calibration could not be applied to the last image
+     * because its size or type was different.
+     */
+    bool mismatched();
+
+    QSharedPointer<const Calibration> calibration();
+
+    //! Maps a calibration file. Returns false if it cannot be used.
+    bool load(QString fileName) override;
+
+    //! Writes the calibration to a file that load() can map.
+    bool save(QString fileName) override;
+
+private:
+    void accumulate(const cv::Mat& image);
+
+    QSharedPointer<const Calibration> current;
+    std::atomic<bool> mismatch;
+    // Guarded by the lock.
+    CaptureKind captureKind;
+
+    friend class FlatFieldSettingsWidget;
+};
+
+class FlatFieldPlugin : public QObject, public ImageFilterPlugin {
+    Q_OBJECT
+    Q_INTERFACES(QArv::ImageFilterPlugin)
+    Q_PLUGIN_METADATA(IID "si.ad-vega.qarv.FlatFieldFilter")
+
+public:
+    QString name() override;
+    ImageFilter* makeFilter() override;
+};
+
+class FlatFieldSettingsWidget : public CalibrationSettingsWidget,
+                                private Ui_flatFieldSettingsWidget {
+    Q_OBJECT
+
+public:
+    FlatFieldSettingsWidget(ImageFilter* filter,
+                            QWidget* parent = 0);
+
+protected slots:
+    void setLiveUpdate(bool enabled) override;
+    void applySettings() override;
+
+    void updateStatus() override;
+
+private slots:
+    void on_darkButton_clicked(bool checked);
+    void on_flatButton_clicked(bool checked);
+
+private:
+    FlatFieldFilter* filter();
+};
+
+};
+
+#endif
@@ -31,7 +31,51 @@ ImageFilter* LevelsPlugin::makeFilter() {
     return new LevelsFilter(this);
 }
 
+/*
+ * Integer images are filtered with a lookup table. Values are taken relative
+ * to the largest value of the type, so the table depends only on the
+ * settings.
+ */
 void LevelsFilter::filterImage(cv::Mat& image) {
+    const int depth = image.depth();
+    if (depth != CV_8U && depth != CV_16U) {
+        filterFloat(image);
+        return;
+    }
+    applyTable(image, table(depth)->values);
+}
+
+QSharedPointer<const LevelsFilter::Table> LevelsFilter::table(int depth) {
+    const double b = black.load(std::memory_order_relaxed),
+                 w = white.load(std::memory_order_relaxed),
+                 g = gamma.load(std::memory_order_relaxed);
+    QMutexLocker l(&tableLock);
+    auto& t = tables[depth == CV_8U ? 0 : 1];
+    if (t && t->black == b && t->white == w && t->gamma == g)
+        return t;
+    auto table = new Table { b, w, g, {} };
+    const int max = depth == CV_8U ? 255 : 65535;
+    const double invGamma = 1. / g;
+    const double low = pow(b, invGamma), high = pow(w, invGamma);
+    cv::Mat values(1, max + 1, CV_64F);
+    for (int i = 0; i <= max; i++) {
+        const double v = pow(double(i) / max, invGamma);
+        double out;
+        if (high != low)
+            out = max * (v - low) / (high - low);
+        else
+            out = v < low ? 0 : max;
+        values.at<double>(i) = out;
+    }
+    // Rounds and saturates like the conversion of the float result did.
+    values.convertTo(table->values, depth);
+    t = QSharedPointer<const Table>(table);
+    return t;
+}
+
+// Used for images that are not 8 or 16-bit; values are taken relative to
+// the largest one in the image.
+void LevelsFilter::filterFloat(cv::Mat& image) {
     float g = 1. / gamma.load(std::memory_order_relaxed);
     float b = pow(black.load(std::memory_order_relaxed), g);
     float w = pow(white.load(std::memory_order_relaxed), g);
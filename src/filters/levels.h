@@ -22,6 +22,8 @@
 
 #include "filters/filter.h"
 #include "ui_levels.h"
+#include <QMutex>
+#include <QSharedPointer>
 #include <atomic>
 
 namespace QArv
@@ -34,9 +36,21 @@ public:
     void restoreSettings() override;
     void saveSettings() override;
     void filterImage(cv::Mat& image) override;
+    bool isPointOperation() override { return true; }
 
 private:
+    // Maps each value of an 8 or 16-bit image to its filtered value.
+    struct Table {
+        double black, white, gamma;
+        cv::Mat values;
+    };
+    QSharedPointer<const Table> table(int depth);
+    void filterFloat(cv::Mat& image);
+
     std::atomic<double> black, white, gamma;
+    // Tables for CV_8U and CV_16U, rebuilt when the settings change.
+    QMutex tableLock;
+    QSharedPointer<const Table> tables[2];
 
     friend class LevelsSettingsWidget;
 };
@@ -0,0 +1,230 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "imagetransform.h"
+#include "decoders/parallelstrips.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace QArv;
+
+/*
+ * Composing the GUI's flip with its rotation, where rotation by a quarter
+ * turn is a transposition followed by flip code 0, and by three quarters a
+ * transposition followed by flip code 1.
+ */
+ImageTransform::ImageTransform(bool invert_, int flip, int rot) :
+    invert(invert_), transpose(rot == 1 || rot == 3) {
+    const bool flipRows = flip == 0 || flip == -1;
+    const bool flipCols = flip == 1 || flip == -1;
+    switch (rot) {
+    case 1:
+        reverseRows = flipRows;
+        reverseCols = !flipCols;
+        break;
+
+    case 2:
+        reverseRows = !flipRows;
+        reverseCols = !flipCols;
+        break;
+
+    case 3:
+        reverseRows = !flipRows;
+        reverseCols = flipCols;
+        break;
+
+    default:
+        reverseRows = flipRows;
+        reverseCols = flipCols;
+        break;
+    }
+}
+
+bool ImageTransform::isIdentity() const {
+    return !invert && isInPlace();
+}
+
+bool ImageTransform::isInPlace() const {
+    return !transpose && !reverseRows && !reverseCols;
+}
+
+cv::Size ImageTransform::outputSize(cv::Size input) const {
+    return transpose ? cv::Size(input.height, input.width) : input;
+}
+
+namespace
+{
+
+template <typename T, int channels>
+struct Pixel {
+    T c[channels];
+};
+
+// Inverting unsigned samples is the same as flipping all their bits.
+template <bool invert, typename T, int channels>
+inline Pixel<T, channels> convert(const Pixel<T, channels>& in) {
+    Pixel<T, channels> out;
+    for (int i = 0; i < channels; i++)
+        out.c[i] = invert ? T(~in.c[i]) : in.c[i];
+    return out;
+}
+
+template <bool invert, typename P>
+void reverseRow(const P* in, P* out, int width) {
+    for (int x = 0; x < width; x++)
+        out[x] = convert<invert>(in[width - 1 - x]);
+}
+
+// Compilers do not vectorize reversing bytes, so it is done a word at a time.
+template <bool invert>
+void reverseRow(const Pixel<uint8_t, 1>* in, Pixel<uint8_t, 1>* out,
+                int width) {
+    const uint8_t* src = in->c;
+    uint8_t* dst = out->c;
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint64_t word;
+        std::memcpy(&word, src + width - 8 - x, 8);
+        word = __builtin_bswap64(word);
+        if (invert)
+            word = ~word;
+        std::memcpy(dst + x, &word, 8);
+    }
+    for (; x < width; x++)
+        out[x] = convert<invert>(in[width - 1 - x]);
+}
+
+enum { tileSize = 32 };
+
+template <typename P, bool invert>
+void transformRows(const cv::Mat& input, cv::Mat& output,
+                   bool reverseRows, bool reverseCols, int begin, int end) {
+    const int width = output.cols, height = output.rows;
+    for (int y = begin; y < end; y++) {
+        const P* in = input.ptr<P>(reverseRows ? height - 1 - y : y);
+        P* out = output.ptr<P>(y);
+        if (reverseCols) {
+            reverseRow<invert>(in, out, width);
+        } else if (invert) {
+            for (int x = 0; x < width; x++)
+                out[x] = convert<invert>(in[x]);
+        } else if (out != in) {
+            std::memcpy(out, in, width * sizeof(P));
+        }
+    }
+}
+
+// Output rows correspond to input columns and vice versa.
+template <typename P, bool invert>
+void transformTiles(const cv::Mat& input, cv::Mat& output,
+                    bool reverseRows, bool reverseCols, int begin, int end) {
+    const int width = output.cols, height = output.rows;
+    for (int y0 = begin; y0 < end; y0 += tileSize) {
+        const int y1 = std::min<int>(end, y0 + tileSize);
+        for (int x0 = 0; x0 < width; x0 += tileSize) {
+            const int x1 = std::min<int>(width, x0 + tileSize);
+            const P* rows[tileSize];
+            for (int x = x0; x < x1; x++)
+                rows[x - x0] = input.ptr<P>(reverseRows ? width - 1 - x : x);
+            for (int y = y0; y < y1; y++) {
+                const int column = reverseCols ? height - 1 - y : y;
+                P* out = output.ptr<P>(y) + x0;
+                for (int x = 0; x < x1 - x0; x++)
+                    out[x] = convert<invert>(rows[x][column]);
+            }
+        }
+    }
+}
+
+template <typename T, int channels, bool invert>
+void transform(const cv::Mat& input, cv::Mat& output, bool transpose,
+               bool reverseRows, bool reverseCols) {
+    typedef Pixel<T, channels> P;
+    forEachStrip(output.rows, output.cols, transpose ? tileSize : 1,
+                 [&] (int begin, int end) {
+        if (transpose)
+            transformTiles<P, invert>(input, output, reverseRows, reverseCols,
+                                      begin, end);
+        else
+            transformRows<P, invert>(input, output, reverseRows, reverseCols,
+                                     begin, end);
+    });
+}
+
+template <typename T, int channels>
+void transform(const cv::Mat& input, cv::Mat& output, bool invert,
+               bool transpose, bool reverseRows, bool reverseCols) {
+    if (invert)
+        transform<T, channels, true>(input, output, transpose,
+                                     reverseRows, reverseCols);
+    else
+        transform<T, channels, false>(input, output, transpose,
+                                      reverseRows, reverseCols);
+}
+
+// Other types are left to OpenCV, in several passes.
+void transformGeneric(const cv::Mat& input, cv::Mat& output, bool invert,
+                      bool transpose, bool reverseRows, bool reverseCols) {
+    cv::Mat image = input;
+    if (transpose) {
+        cv::transpose(input, image);
+        // The input rows became the columns.
+        std::swap(reverseRows, reverseCols);
+    }
+    if (reverseRows || reverseCols)
+        cv::flip(image, output, reverseRows && reverseCols ? -1 :
+                                reverseRows ? 0 : 1);
+    else if (image.data != output.data)
+        image.copyTo(output);
+    if (invert) {
+        const int bits = input.depth() == CV_8U ? 8 : 16;
+        cv::subtract(cv::Scalar::all((1 << bits) - 1), output, output);
+    }
+}
+
+}
+
+void ImageTransform::apply(const cv::Mat& input, cv::Mat& output) const {
+    switch (input.type()) {
+    case CV_8UC1:
+        transform<uint8_t, 1>(input, output, invert, transpose,
+                              reverseRows, reverseCols);
+        break;
+
+    case CV_8UC3:
+        transform<uint8_t, 3>(input, output, invert, transpose,
+                              reverseRows, reverseCols);
+        break;
+
+    case CV_16UC1:
+        transform<uint16_t, 1>(input, output, invert, transpose,
+                               reverseRows, reverseCols);
+        break;
+
+    case CV_16UC3:
+        transform<uint16_t, 3>(input, output, invert, transpose,
+                               reverseRows, reverseCols);
+        break;
+
+    default:
+        transformGeneric(input, output, invert, transpose,
+                         reverseRows, reverseCols);
+        break;
+    }
+}
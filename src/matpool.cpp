@@ -0,0 +1,70 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "matpool.h"
+
+using namespace QArv;
+
+// A frame may be needed in several geometries at once, e.g. transposed
+// when rotating, and as a smaller preview.
+static const int retainedGeometries = 4;
+
+MatPool::MatPool(int maxBuffers) : maxBuffers(maxBuffers) {}
+
+// Only the pool holds a reference, so nobody else can be adding one.
+static inline bool isFree(const cv::Mat& m) {
+    return m.u && m.u->refcount == 1;
+}
+
+bool MatPool::isRecent(const cv::Mat& m) const {
+    return recentGeometries.contains(Geometry{m.rows, m.cols, m.type()});
+}
+
+cv::Mat MatPool::take(int rows, int cols, int type) {
+    QMutexLocker l(&lock);
+    const Geometry geometry{rows, cols, type};
+    if (recentGeometries.isEmpty() || !(recentGeometries.first() == geometry)) {
+        recentGeometries.removeAll(geometry);
+        recentGeometries.prepend(geometry);
+        while (recentGeometries.size() > retainedGeometries)
+            recentGeometries.removeLast();
+    }
+    for (int i = 0; i < buffers.size(); i++) {
+        const cv::Mat& m = buffers.at(i);
+        if (m.rows == rows && m.cols == cols && m.type() == type && isFree(m))
+            return m;
+    }
+    // The geometry has changed, or all buffers are in use. Free buffers of
+    // geometries that have not been asked for lately are not likely to be
+    // needed again.
+    for (int i = buffers.size() - 1; i >= 0; i--) {
+        const cv::Mat& m = buffers.at(i);
+        if (isFree(m) && !isRecent(m))
+            buffers.removeAt(i);
+    }
+    cv::Mat m(rows, cols, type);
+    if (buffers.size() < maxBuffers)
+        buffers << m;
+    return m;
+}
+
+void MatPool::clear() {
+    QMutexLocker l(&lock);
+    buffers.clear();
+}
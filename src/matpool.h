@@ -0,0 +1,70 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATPOOL_H
+#define MATPOOL_H
+
+#include <QList>
+#include <QMutex>
+#include <opencv2/core/core.hpp>
+
+namespace QArv
+{
+
+/*
+ * A set of image buffers that are reused once nobody references them any
+ * more. cv::Mat is reference counted, so a buffer is free when the pool's
+ * own header is the only one left. Images handed out by the pool can thus be
+ * shared freely as long as nobody writes to them after they have been
+ * passed on; whoever wants to modify one must clone it.
+ *
+ * Thread-safe.
+ */
+class MatPool {
+public:
+    explicit MatPool(int maxBuffers = 64);
+
+    // Returns an image of the given geometry that nobody else references.
+    // Its contents are undefined.
+    cv::Mat take(int rows, int cols, int type);
+
+    // Forgets all buffers. Those still in use are freed when released.
+    void clear();
+
+private:
+    struct Geometry {
+        int rows, cols, type;
+        bool operator==(const Geometry& other) const {
+            return rows == other.rows && cols == other.cols
+                   && type == other.type;
+        }
+    };
+
+    bool isRecent(const cv::Mat& m) const;
+
+    QMutex lock;
+    QList<cv::Mat> buffers;
+    // Most recently requested first.
+    QList<Geometry> recentGeometries;
+    const int maxBuffers;
+};
+
+}
+
+#endif
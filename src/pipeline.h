@@ -0,0 +1,121 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QThread>
+#include <functional>
+
+namespace QArv
+{
+
+/*
+ * A blocking FIFO of limited length, used to connect pipeline stages.
+ * push() waits while the queue is full, which is what propagates
+ * backpressure from a slow stage to the ones in front of it. Once closed,
+ * push() fails and pop() fails as soon as the queue is drained.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(int capacity) : capacity(capacity) {}
+
+    bool push(const T& value) {
+        QMutexLocker l(&lock);
+        while (!closed && items.size() >= capacity)
+            notFull.wait(&lock);
+        if (closed)
+            return false;
+        items.enqueue(value);
+        notEmpty.wakeOne();
+        return true;
+    }
+
+    bool pop(T& value) {
+        QMutexLocker l(&lock);
+        while (!closed && items.isEmpty())
+            notEmpty.wait(&lock);
+        if (items.isEmpty())
+            return false;
+        value = items.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    bool isFull() {
+        QMutexLocker l(&lock);
+        return items.size() >= capacity;
+    }
+
+    // Removes the oldest item without waiting. Returns false if empty.
+    bool takeOldest(T& value) {
+        QMutexLocker l(&lock);
+        if (items.isEmpty())
+            return false;
+        value = items.dequeue();
+        notFull.wakeOne();
+        return true;
+    }
+
+    void close() {
+        QMutexLocker l(&lock);
+        closed = true;
+        notEmpty.wakeAll();
+        notFull.wakeAll();
+    }
+
+    // Only call once nobody is waiting on the queue any more.
+    void reopen() {
+        QMutexLocker l(&lock);
+        closed = false;
+    }
+
+    int size() {
+        QMutexLocker l(&lock);
+        return items.size();
+    }
+
+private:
+    QMutex lock;
+    QWaitCondition notEmpty, notFull;
+    QQueue<T> items;
+    const int capacity;
+    bool closed = false;
+};
+
+// A thread that runs a single function, typically a loop over a queue.
+class StageThread : public QThread {
+public:
+    StageThread(std::function<void()> body, QObject* parent = 0) :
+        QThread(parent), body(body) {}
+
+protected:
+    void run() override { body(); }
+
+private:
+    std::function<void()> body;
+};
+
+}
+
+#endif
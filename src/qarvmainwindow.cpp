@@ -47,12 +47,13 @@ Q_DECLARE_METATYPE(cv::Mat)
 using namespace QArv;
 
 QArvMainWindow::QArvMainWindow(QWidget* parent, bool standalone_) :
-    QMainWindow(parent), camera(NULL), decoder(NULL), playing(false),
+    QMainWindow(parent), camera(NULL), decoder(NULL), previewDecoder(NULL),
+    playing(false),
     recording(false), started(false), drawHistogram(false),
     standalone(standalone_), imageTransform(),
     imageTransform_flip(0), imageTransform_rot(0),
     toDisableWhenPlaying(), toDisableWhenRecording(), futureHoldsAHistogram(
-        false),
+        false), renderIdle(false),
     recordingTimeCumulative(0) {
 
     setAttribute(Qt::WA_DeleteOnClose);
@@ -562,14 +563,22 @@ void QArvMainWindow::frameRendered() {
             histogram->swapHistograms(CV_MAT_CN(decoder->cvType()) == 1);
     }
     bool dohist = histogramdock->isVisible();
-    if (playing || dohist) {
-        futureHoldsAHistogram = dohist;
-        Histograms* hists = dohist ? histogram->unusedHistograms() : nullptr;
-        workthread->renderFrame(video->unusedFrame(),
-                                markClipped->isChecked(),
-                                hists,
-                                histogramLog->isChecked());
-    }
+    // Nothing is decoded for display while neither is shown.
+    renderIdle = !(playing && !videodock->isHidden()) && !dohist;
+    if (!renderIdle)
+        requestRender();
+}
+
+// Asks the workthread to render the next frame for the video and histogram.
+void QArvMainWindow::requestRender() {
+    renderIdle = false;
+    futureHoldsAHistogram = histogramdock->isVisible();
+    Histograms* hists = futureHoldsAHistogram ?
+                        histogram->unusedHistograms() : nullptr;
+    workthread->renderFrame(video->unusedFrame(),
+                            markClipped->isChecked(),
+                            hists,
+                            histogramLog->isChecked());
 }
 
 void QArvMainWindow::startVideo(bool start) {
@@ -578,12 +587,19 @@ void QArvMainWindow::startVideo(bool start) {
             cameraSelector,
             refreshCamerasButton,
             streamFramesSpinbox,
+            streamBudgetSpinbox,
+            workerCountSpinbox,
+            decodeThreadsSpinbox,
+            dropPolicySelector,
+            framesInFlightSpinbox,
             useFastInterpolator,
+            halfResPreviewCheck,
         };
     if (camera != NULL) {
         setEnabled(false);
         if (start && !started) {
             if (decoder != NULL) delete decoder;
+            QArvDecoder::setDecodingThreads(decodeThreadsSpinbox->value());
             decoder = QArvDecoder::makeDecoder(camera->getPixelFormatId(),
                                                camera->getROI().size(),
                                                useFastInterpolator->isChecked());
@@ -597,8 +613,17 @@ void QArvMainWindow::startVideo(bool start) {
                                               camera->getROI().size());
             }
             if (decoder != NULL) {
-                workthread->newCamera(camera, decoder);
+                if (halfResPreviewCheck->isChecked())
+                    previewDecoder = QArvDecoder::makePreviewDecoder(
+                        camera->getPixelFormatId(), camera->getROI().size());
+                updateSelectionSize();
+                workthread->newCamera(camera, decoder, previewDecoder);
+                workthread->setWorkerCount(workerCountSpinbox->value());
+                workthread->setDropPolicy(
+                    Workthread::DropPolicy(dropPolicySelector->currentIndex()),
+                    framesInFlightSpinbox->value());
                 camera->setFrameQueueSize(streamFramesSpinbox->value());
+                camera->setFrameQueueBudget(streamBudgetSpinbox->value());
                 workthread->startCamera(nocopyCheck->isChecked(),
                                         dropInvalidFrames->isChecked());
                 started = true;
@@ -614,6 +639,9 @@ void QArvMainWindow::startVideo(bool start) {
             workthread->newCamera(nullptr, nullptr);
             if (decoder != NULL) delete decoder;
             decoder = NULL;
+            delete previewDecoder;
+            previewDecoder = NULL;
+            updateSelectionSize();
             bool open = recorder && recorder->isOK();
             foreach (auto wgt, toDisableWhenPlaying) {
                 wgt->setEnabled(!recording && !open);
@@ -633,17 +661,10 @@ void QArvMainWindow::on_playButton_toggled(bool checked) {
     startVideo(playing || recording);
     playing = checked && started;
     playButton->setChecked(playing);
-    bool dohist = histogramdock->isVisible();
-    if (!playing) {
+    if (!playing)
         video->setImage();
-    } else {
-        futureHoldsAHistogram = dohist;
-        Histograms* hists = dohist ? histogram->unusedHistograms() : nullptr;
-        workthread->renderFrame(video->unusedFrame(),
-                                markClipped->isChecked(),
-                                hists,
-                                histogramLog->isChecked());
-    }
+    else
+        requestRender();
 }
 
 void QArvMainWindow::on_recordAction_toggled(bool checked) {
@@ -804,8 +825,8 @@ skip_all_file_opening:
 
 void QArvMainWindow::on_snapshotAction_toggled(bool checked) {
     if (!checked) {
-        disconnect(workthread, SIGNAL(frameDelivered(QByteArray,ArvBuffer*)),
-                   this, SLOT(snapshotRare(QByteArray)));
+        disconnect(workthread, SIGNAL(frameDelivered(QArvFramePtr)),
+                   this, SLOT(snapshotRare(QArvFramePtr)));
         disconnect(workthread, SIGNAL(frameCooked(cv::Mat)),
                    this, SLOT(snapshotCooked(cv::Mat)));
         return;
@@ -840,23 +861,23 @@ void QArvMainWindow::on_snapshotAction_toggled(bool checked) {
         connect(workthread, SIGNAL(frameCooked(cv::Mat)),
                 this, SLOT(snapshotCooked(cv::Mat)));
     else
-        connect(workthread, SIGNAL(frameDelivered(QByteArray,ArvBuffer*)),
-                this, SLOT(snapshotRare(QByteArray)));
+        connect(workthread, SIGNAL(frameDelivered(QArvFramePtr)),
+                this, SLOT(snapshotRare(QArvFramePtr)));
 }
 
-void QArvMainWindow::snapshotRare(QByteArray frame) {
+void QArvMainWindow::snapshotRare(QArvFramePtr rawFrame) {
     snapshotAction->setChecked(false);
     auto time = QDateTime::currentDateTime();
     QString fileName = snappathEdit->text() + "/"
                        + snapbasenameEdit->text()
                        + time.toString("yyyy-MM-dd-hhmmss.zzz");
-    if (frame.isEmpty()) {
+    if (rawFrame->isEmpty()) {
         statusBar()->showMessage(tr("Current frame is invalid, try "
                                     "snapshotting again."), statusTimeoutMsec);
         return;
     }
     QFile file(fileName + ".frame");
-    if (file.open(QIODevice::WriteOnly)) file.write(frame);
+    if (file.open(QIODevice::WriteOnly)) file.write(rawFrame->data());
     else
         statusBar()->showMessage(tr("Snapshot cannot be written."),
                                  statusTimeoutMsec);
@@ -901,6 +922,8 @@ void QArvMainWindow::pickedROI(QRect roi) {
     // be calculated using the size of the actual image, so we get this size
     // from the camera.
     auto imagesize = camera->getROI().size();
+    if (previewDecoder)
+        roi = QRect(roi.topLeft() * 2, roi.size() * 2);
     auto truexform = QImage::trueMatrix(imageTransform,
                                         imagesize.width(),
                                         imagesize.height());
@@ -1021,6 +1044,17 @@ void QArvMainWindow::updateImageTransform() {
 
 void QArvMainWindow::showFPS() {
     actualFPS->setText(QString::number(workthread->getFps()));
+    auto depths = workthread->getQueueDepths();
+    actualFPS->setToolTip(tr("Frames waiting to be decoded: %1\n"
+                             "Frames waiting to be transformed: %2\n"
+                             "Frames waiting for an earlier frame: %3\n"
+                             "Frames waiting to be recorded and shown: %4\n"
+                             "Frames dropped: %5")
+                          .arg(depths.decode)
+                          .arg(depths.transform)
+                          .arg(depths.reorder)
+                          .arg(depths.sink)
+                          .arg(workthread->getDroppedFrames()));
 }
 
 void QArvMainWindow::on_editExposureButton_clicked(bool checked) {
@@ -1068,6 +1102,8 @@ void QArvMainWindow::on_videodock_visibilityChanged(bool visible) {
     showVideoAction->blockSignals(true);
     showVideoAction->setChecked(!videodock->isHidden());
     showVideoAction->blockSignals(false);
+    if (renderIdle && playing && !videodock->isHidden())
+        requestRender();
 }
 
 void QArvMainWindow::on_videodock_topLevelChanged(bool floating) {
@@ -1082,6 +1118,8 @@ void QArvMainWindow::on_histogramdock_visibilityChanged(bool visible) {
     showHistogramAction->blockSignals(true);
     showHistogramAction->setChecked(!histogramdock->isHidden());
     showHistogramAction->blockSignals(false);
+    if (renderIdle && visible)
+        requestRender();
 }
 
 void QArvMainWindow::on_histogramdock_topLevelChanged(bool floating) {
@@ -1124,7 +1162,14 @@ void QArvMainWindow::on_closeFileAction_triggered(bool checked) {
 }
 
 void QArvMainWindow::on_ROIsizeCombo_newSizeSelected(QSize size) {
-    video->setSelectionSize(size);
+    roiSelectionSize = size;
+    updateSelectionSize();
+}
+
+// The preview image is half the size of the frame.
+void QArvMainWindow::updateSelectionSize() {
+    video->setSelectionSize(previewDecoder ? roiSelectionSize / 2
+                                           : roiSelectionSize);
 }
 
 void QArvMainWindow::histogramNextFrame() {
@@ -1188,8 +1233,14 @@ void QArvMainWindow::setupListOfSavedWidgets() {
     saved_widgets["qarv_settings/histogram_update_ms"] = histogramUpdateSpinbox;
     saved_widgets["qarv_settings/statusbar_timeout"] = statusTimeoutSpinbox;
     saved_widgets["qarv_settings/frame_queue_size"] = streamFramesSpinbox;
+    saved_widgets["qarv_settings/frame_queue_budget"] = streamBudgetSpinbox;
+    saved_widgets["qarv_settings/frame_workers"] = workerCountSpinbox;
+    saved_widgets["qarv_settings/decoding_threads"] = decodeThreadsSpinbox;
+    saved_widgets["qarv_settings/drop_policy"] = dropPolicySelector;
+    saved_widgets["qarv_settings/frames_in_flight"] = framesInFlightSpinbox;
     saved_widgets["qarv_settings/frame_transfer_nocopy"] = nocopyCheck;
     saved_widgets["qarv_settings/fast_swscale"] = useFastInterpolator;
+    saved_widgets["qarv_settings/half_res_preview"] = halfResPreviewCheck;
 
     //recording tab
     saved_widgets["qarv_recording/snapshot_directory"] = snappathEdit;
@@ -114,16 +114,22 @@ private slots:
     void bufferUnderrunOccured();
     void addPostprocFilter();
     void updatePostprocQList();
-    void snapshotRare(QByteArray frame);
+    void snapshotRare(QArvFramePtr frame);
     void snapshotCooked(cv::Mat frame);
 
 private:
     void readROILimits();
+    void updateSelectionSize();
     void stopAllAcquisition();
+    void requestRender();
     void closeEvent(QCloseEvent* event) override;
 
     QArvCamera* camera;
     QArvDecoder* decoder;
+    // Used for display only, if enabled and supported by the format.
+    QArvDecoder* previewDecoder;
+    // Size of the fixed ROI selection, in camera pixels.
+    QSize roiSelectionSize;
     QRect roirange, roidefault;
     QPair<double, double> gainrange, exposurerange;
     QTimer* autoreadexposure;
@@ -139,6 +145,8 @@ private:
     QMap<QString, QWidget*> saved_widgets;
     QScopedPointer<Recorder> recorder;
     bool futureHoldsAHistogram;
+    // No render request is outstanding because nothing is shown.
+    bool renderIdle;
     QFile timestampFile;
     QLabel* recordingTimeLabel;
     QElapsedTimer recordingTime;
@@ -0,0 +1,89 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012-2014 Jure Varlec <jure.varlec@ad-vega.si>
+                            Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace QArv
+{
+
+/*
+ * A bounded lock-free queue for exactly one producer thread and exactly one
+ * consumer thread. Neither push() nor pop() ever blocks; they fail when the
+ * ring is full or empty, respectively. The capacity is rounded up to a power
+ * of two so that indices can be wrapped with a mask.
+ */
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity = 0) { reset(capacity); }
+
+    // Not thread-safe. Only call while neither side is using the ring.
+    void reset(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity)
+            n <<= 1;
+        slots.assign(n, T());
+        mask = n - 1;
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // Producer side.
+    bool push(const T& value) {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask)
+            return false;
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side.
+    bool pop(T& value) {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        value = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called concurrently with push() or pop().
+    size_t size() const {
+        return tail.load(std::memory_order_acquire)
+               - head.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+}
+
+#endif
@@ -0,0 +1,275 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures how fast each decoder is. Every pixel format that has a decoder
+ * is decoded from synthetic frames of several sizes, the same way the
+ * processing pipeline does it, and one line of statistics is printed per
+ * format and size. With --swscale, the libswscale formats that recorded raw
+ * video may use are measured instead of the Aravis ones. The output is tab
+ * separated with a fixed set of columns, so that runs can be compared with
+ * each other. The first line holds the version of the output format and the
+ * settings.
+ *
+ * Latencies are those of decodeInto() into a reused image, the way the
+ * processing pipeline decodes frames.
+ */
+
+#include <gio/gio.h>  // Workaround for gdbusintrospection's use of "signal".
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QPluginLoader>
+#include <QJsonObject>
+#include <QStringList>
+#include <QMap>
+#include <QSize>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include "api/qarvdecoder.h"
+#include "decoders/unpackers.h"
+extern "C" {
+  #include <arv.h>
+  #include <libavutil/imgutils.h>
+  #include <libavutil/pixdesc.h>
+  #include <libswscale/swscale.h>
+}
+
+/*
+ * Names the formats after the decoder plugins that handle them, so that every
+ * format the plugins support can be picked with --format. Formats without
+ * a plugin are named by their code.
+ */
+static QMap<ArvPixelFormat, QString> pluginFormatNames() {
+    QMap<ArvPixelFormat, QString> names;
+    foreach (auto plugin, QPluginLoader::staticPlugins()) {
+        auto fmt = qobject_cast<QArvPixelFormat*>(plugin.instance());
+        if (!fmt)
+            continue;
+        QString name = plugin.metaData().value("className").toString()
+                       .section("::", -1);
+        if (name.endsWith("Format"))
+            name.chop(6);
+        names[fmt->pixelFormat()] = name;
+    }
+    return names;
+}
+
+// GigE Vision pixel formats carry their size in bits 16 to 23.
+static size_t frameBytes(ArvPixelFormat format, QSize size) {
+    const size_t bits = (format >> 16) & 0xFF;
+    return (size_t(size.width()) * size.height() * bits + 7) / 8;
+}
+
+// One format to benchmark, either an Aravis or a libswscale one.
+struct Format {
+    QString code;
+    QString name;
+    std::function<QArvDecoder*(QSize)> makeDecoder;
+    std::function<size_t(QSize)> frameBytes;
+};
+
+static QList<Format> aravisFormats(bool preview) {
+    auto formats = QArvPixelFormat::supportedFormats();
+    std::sort(formats.begin(), formats.end());
+    formats.erase(std::unique(formats.begin(), formats.end()), formats.end());
+    const auto names = pluginFormatNames();
+    QList<Format> list;
+    foreach (auto format, formats) {
+        Format f;
+        f.code = QString("0x%1").arg(uint(format), 8, 16, QChar('0'));
+        f.name = names.value(format, f.code);
+        f.makeDecoder = [format, preview] (QSize size) {
+            return preview ? QArvDecoder::makePreviewDecoder(format, size)
+                           : QArvDecoder::makeDecoder(format, size);
+        };
+        f.frameBytes = [format] (QSize size) {
+            return frameBytes(format, size);
+        };
+        list << f;
+    }
+    return list;
+}
+
+// Every format that libswscale takes as input, as in recorded raw video.
+static QList<Format> swscaleFormats() {
+    QList<Format> list;
+#ifdef HAVE_FMT_DESC_GET
+    for (auto desc = av_pix_fmt_desc_next(NULL); desc;
+         desc = av_pix_fmt_desc_next(desc)) {
+        const AVPixelFormat format = av_pix_fmt_desc_get_id(desc);
+        if (sws_isSupportedInput(format) <= 0
+            || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL))
+            continue;
+        Format f;
+        f.code = QString("av:%1").arg(int(format));
+        f.name = desc->name;
+        f.makeDecoder = [format] (QSize size) {
+            return QArvDecoder::makeSwScaleDecoder(format, size);
+        };
+        f.frameBytes = [format] (QSize size) {
+            const int bytes = av_image_get_buffer_size(format, size.width(),
+                                                       size.height(), 1);
+            return size_t(std::max(bytes, 0));
+        };
+        list << f;
+    }
+#endif
+    return list;
+}
+
+// Fills the frame with noise that is the same in every run.
+static QByteArray syntheticFrame(size_t bytes) {
+    QByteArray frame(bytes, Qt::Uninitialized);
+    char* data = frame.data();
+    quint32 state = 2463534242u;
+    for (size_t i = 0; i < bytes; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = char(state >> 24);
+    }
+    return frame;
+}
+
+// Nearest-rank percentile of sorted samples.
+static qint64 percentile(const std::vector<qint64>& sorted, int p) {
+    size_t rank = (sorted.size() * p + 99) / 100;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+static QList<QSize> parseSizes(const QString& list, bool* ok) {
+    QList<QSize> sizes;
+    *ok = true;
+    foreach (auto s, list.split(',', QString::SkipEmptyParts)) {
+        const auto wh = s.split('x');
+        bool okW = false, okH = false;
+        const QSize size(wh.value(0).toInt(&okW), wh.value(1).toInt(&okH));
+        if (wh.size() != 2 || !okW || !okH || size.isEmpty()) {
+            *ok = false;
+            return sizes;
+        }
+        sizes << size;
+    }
+    return sizes;
+}
+
+int main(int argc, char** argv) {
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("qarv-bench-decoders");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures the speed of QArv decoders.");
+    parser.addHelpOption();
+    QCommandLineOption sizesOption("sizes",
+        "Comma separated frame sizes.", "WxH,...",
+        "640x480,1280x1024,1920x1080,2448x2048");
+    QCommandLineOption iterationsOption("iterations",
+        "Timed decodes per format and size.", "n", "50");
+    QCommandLineOption warmupOption("warmup",
+        "Untimed decodes before the timed ones.", "n", "5");
+    QCommandLineOption threadsOption("threads",
+        "Threads per frame, 0 for all cores.", "n", "0");
+    QCommandLineOption formatOption("format",
+        "Only benchmark formats whose name contains this.", "name");
+    QCommandLineOption previewOption("preview",
+        "Benchmark preview decoders instead.");
+    QCommandLineOption swscaleOption("swscale",
+        "Benchmark libswscale decoders of ffmpeg pixel formats instead.");
+    parser.addOptions({ sizesOption, iterationsOption, warmupOption,
+                        threadsOption, formatOption, previewOption,
+                        swscaleOption });
+    parser.process(a);
+
+    bool ok;
+    const auto sizes = parseSizes(parser.value(sizesOption), &ok);
+    const int iterations = parser.value(iterationsOption).toInt();
+    const int warmup = parser.value(warmupOption).toInt();
+    const int threads = parser.value(threadsOption).toInt();
+    if (!ok || sizes.isEmpty() || iterations < 1 || warmup < 0
+        || threads < 0) {
+        fprintf(stderr, "Invalid arguments.\n");
+        return 1;
+    }
+    const QString filter = parser.value(formatOption);
+    const bool preview = parser.isSet(previewOption);
+    const bool swscale = parser.isSet(swscaleOption);
+    if (preview && swscale) {
+        fprintf(stderr, "libswscale decoders have no preview.\n");
+        return 1;
+    }
+
+    QArvDecoder::setDecodingThreads(threads);
+
+    const auto formats = swscale ? swscaleFormats() : aravisFormats(preview);
+
+    printf("# qarv-bench-decoders 2 threads=%d simd=%s iterations=%d%s\n",
+           threads, QArv::unpackerInstructionSet(), iterations,
+           preview ? " preview" : swscale ? " swscale" : "");
+    printf("format\tname\twidth\theight\tbytes\tMB/s\tns/px"
+           "\tp50_us\tp90_us\tp99_us\tmax_us\n");
+    foreach (const auto& format, formats) {
+        if (!filter.isEmpty()
+            && !format.name.contains(filter, Qt::CaseInsensitive)
+            && !format.code.contains(filter, Qt::CaseInsensitive))
+            continue;
+        foreach (auto size, sizes) {
+            QArvDecoder* decoder = format.makeDecoder(size);
+            // Decoders that cannot handle the size produce no image.
+            if (!decoder || decoder->imageSize().isEmpty()) {
+                delete decoder;
+                continue;
+            }
+            const size_t bytes = format.frameBytes(size);
+            const QByteArray frame = syntheticFrame(bytes);
+            cv::Mat image;
+            for (int i = 0; i < warmup; i++)
+                decoder->decodeInto(frame, image);
+            std::vector<qint64> times;
+            times.reserve(iterations);
+            QElapsedTimer timer;
+            for (int i = 0; i < iterations; i++) {
+                timer.start();
+                decoder->decodeInto(frame, image);
+                times.push_back(timer.nsecsElapsed());
+            }
+            delete decoder;
+
+            double total = 0;
+            for (auto t : times)
+                total += t;
+            const double mean = total / iterations;
+            std::sort(times.begin(), times.end());
+            printf("%s\t%s\t%d\t%d\t%zu\t%.1f\t%.3f"
+                   "\t%.1f\t%.1f\t%.1f\t%.1f\n",
+                   qPrintable(format.code), qPrintable(format.name),
+                   size.width(), size.height(), bytes,
+                   bytes / mean * 1e3,
+                   mean / (double(size.width()) * size.height()),
+                   percentile(times, 50) / 1e3,
+                   percentile(times, 90) / 1e3,
+                   percentile(times, 99) / 1e3,
+                   times.back() / 1e3);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
@@ -23,10 +23,7 @@
 #include "recorders/recorder.h"
 #include <QThread>
 #include <QCoreApplication>
-
-extern "C" {
-#include <arv.h>
-}
+#include <QMetaMethod>
 
 using namespace QArv;
 
@@ -47,6 +44,8 @@ Workthread::Workthread(QObject* parent) : QObject(parent) {
     cooker->moveToThread(cookerThread);
     connect(cookerThread, SIGNAL(finished()), cooker, SLOT(deleteLater()));
     connect(cooker, SIGNAL(frameCooked(cv::Mat)), SIGNAL(frameCooked(cv::Mat)));
+    connect(cooker, SIGNAL(frameDelivered(QArvFramePtr)),
+            SIGNAL(frameDelivered(QArvFramePtr)));
     connect(cooker, SIGNAL(recordingStopped()), SIGNAL(recordingStopped()));
 
     cookerThread->setObjectName("QArv Cooker");
@@ -75,26 +74,31 @@ Workthread::~Workthread() {
     rendererThread->wait();
 }
 
-void Workthread::newCamera(QArvCamera* camera_, QArvDecoder* decoder) {
+void Workthread::newCamera(QArvCamera* camera_, QArvDecoder* decoder,
+                           QArvDecoder* previewDecoder) {
     if (camera) {
-        disconnect(camera, SIGNAL(frameReady(QByteArray,ArvBuffer*)),
-                   cooker, SLOT(processFrame(QByteArray,ArvBuffer*)));
-        disconnect(camera, SIGNAL(frameReady(QByteArray,ArvBuffer*)),
-                   this, SIGNAL(frameDelivered(QByteArray,ArvBuffer*)));
+        disconnect(camera, SIGNAL(framesQueued()),
+                   cooker, SLOT(drainFrames()));
         QMetaObject::invokeMethod(cooker,
                                   "returnCamera",
                                   Qt::BlockingQueuedConnection,
                                   Q_ARG(QArvCamera*, camera),
                                   Q_ARG(QThread*, thread()));
+        camera->setFrameRingDelivery(false);
     }
+    // The camera is stopped at this point, so the Cooker is not touching
+    // its parameters.
     cooker->p.decoder = decoder;
+    cooker->p.previewDecoder = previewDecoder;
+    cooker->p.decoderGeneration++;
+    cooker->params.clear();
+    cooker->camera = camera_;
     camera = camera_;
     if (camera) {
+        camera->setFrameRingDelivery(true);
         camera->moveToThread(cooker->thread());
-        connect(camera, SIGNAL(frameReady(QByteArray,ArvBuffer*)),
-                cooker, SLOT(processFrame(QByteArray,ArvBuffer*)));
-        connect(camera, SIGNAL(frameReady(QByteArray,ArvBuffer*)),
-                this, SIGNAL(frameDelivered(QByteArray,ArvBuffer*)));
+        connect(camera, SIGNAL(framesQueued()),
+                cooker, SLOT(drainFrames()), Qt::QueuedConnection);
     }
 }
 
@@ -149,10 +153,11 @@ void QArv::Workthread::setFilterChain(QVector<QArv::ImageFilterPtr> filterChain)
 }
 
 void Workthread::waitUntilProcessingCycleCompletes() {
-    QMetaObject::invokeMethod(renderer,
+    QMetaObject::invokeMethod(cooker,
                               "processEvents",
                               Qt::BlockingQueuedConnection);
-    QMetaObject::invokeMethod(cooker,
+    cooker->waitForPipeline();
+    QMetaObject::invokeMethod(renderer,
                               "processEvents",
                               Qt::BlockingQueuedConnection);
 }
@@ -174,11 +179,128 @@ uint Workthread::getFps() {
     return fps;
 }
 
-Cooker::Cooker(QObject* parent) : QObject(parent) {
+Workthread::QueueDepths Workthread::getQueueDepths() {
+    QueueDepths depths;
+    depths.decode = cooker->decodeQueue.size();
+    depths.transform = cooker->transformQueue.size();
+    depths.reorder = cooker->reorderDepth.load(std::memory_order_relaxed);
+    depths.sink = cooker->sinkQueue.size();
+    return depths;
+}
+
+void Workthread::connectNotify(const QMetaMethod& signal) {
+    updateConsumers();
+}
+
+void Workthread::disconnectNotify(const QMetaMethod& signal) {
+    updateConsumers();
+}
+
+void Workthread::updateConsumers() {
+    static const auto cookedSignal =
+        QMetaMethod::fromSignal(&Workthread::frameCooked);
+    cooker->cookedWanted.store(isSignalConnected(cookedSignal));
+}
+
+void Workthread::setDropPolicy(DropPolicy policy, int maxInFlight) {
+    QMetaObject::invokeMethod(cooker, "setDropPolicy", Qt::QueuedConnection,
+                              Q_ARG(int, policy),
+                              Q_ARG(int, maxInFlight));
+}
+
+quint64 Workthread::getDroppedFrames() {
+    return cooker->droppedFrames.load(std::memory_order_relaxed);
+}
+
+void Workthread::setWorkerCount(int workers) {
+    QMetaObject::invokeMethod(cooker, "setWorkerCount",
+                              Qt::BlockingQueuedConnection,
+                              Q_ARG(int, workers));
+}
+
+// Frames held in the queues between stages are not available to the camera,
+// so the queues are kept short.
+static const int stageQueueLength = 4;
+
+// Frames taken off the camera's ring before returning to the event loop.
+static const int drainBatch = 64;
+
+Cooker::Cooker(QObject* parent) : QObject(parent),
+    decodeQueue(stageQueueLength),
+    transformQueue(stageQueueLength),
+    sinkQueue(stageQueueLength) {
     doRender.store(false);
+    cookedWanted.store(false);
     receivedFrames.store(0);
+    droppedFrames.store(0);
+    dropPolicy = Workthread::BlockStream;
     lastFpsRequestFrames = 0;
     lastFpsRequest.start();
+
+    startStages(1);
+}
+
+Cooker::~Cooker() {
+    stopStages();
+}
+
+void Cooker::startStages(int workers) {
+    workerCount = qMax(1, workers);
+    if (workerCount == 1) {
+        stages << new StageThread([this] () {
+            runStage(decodeQueue, &transformQueue, &Cooker::decodeFrame);
+        });
+        stages.last()->setObjectName("QArv Decoder");
+        stages << new StageThread([this] () {
+            runStage(transformQueue, &sinkQueue, &Cooker::transformFrame);
+        });
+        stages.last()->setObjectName("QArv Transformer");
+    } else {
+        QMutexLocker l(&jobCountLock);
+        nextSequence = jobsStarted;
+        droppedSequences.clear();
+        reorderDepth.store(0);
+        flushTickets = nextFlushTicket = 0;
+        for (int i = 0; i < workerCount; i++) {
+            stages << new StageThread([this] () { runWorker(); });
+            stages.last()->setObjectName(QString("QArv Worker %1").arg(i));
+        }
+    }
+    stages << new StageThread([this] () {
+        runStage(sinkQueue, nullptr, &Cooker::sinkFrame);
+    });
+    stages.last()->setObjectName("QArv Sink");
+    foreach (auto stage, stages) {
+        stage->start();
+    }
+}
+
+// The pipeline must be empty.
+void Cooker::stopStages() {
+    decodeQueue.close();
+    transformQueue.close();
+    sinkQueue.close();
+    foreach (auto stage, stages) {
+        stage->wait();
+        delete stage;
+    }
+    stages.clear();
+    decodeQueue.reopen();
+    transformQueue.reopen();
+    sinkQueue.reopen();
+}
+
+void Cooker::setDropPolicy(int policy, int maxInFlight_) {
+    dropPolicy = policy;
+    maxInFlight = qMax(1, maxInFlight_);
+}
+
+void Cooker::setWorkerCount(int workers) {
+    if (qMax(1, workers) == workerCount)
+        return;
+    waitForPipeline();
+    stopStages();
+    startStages(workers);
 }
 
 void Cooker::processEvents() {
@@ -197,110 +319,362 @@ void Cooker::cameraAcquisition(QArvCamera* camera,
         camera->startAcquisition(zeroCopy, dropInvalidFrames);
         lastFpsRequest.start();
         receivedFrames.store(0);
+        droppedFrames.store(0);
         lastFpsRequestFrames = 0;
     } else {
         camera->stopAcquisition();
     }
 }
 
-void Cooker::processFrame(QByteArray frame, ArvBuffer* aravisFrame) {
-    receivedFrames.fetch_add(1, std::memory_order_relaxed);
-    if (p.decoder) {
-        if (frame.isEmpty()) {
-            emit frameCooked(cv::Mat());
-            if (doRender.load()) {
-                doRender.store(false);
-                emit frameToRender(cv::Mat());
-            }
+void Cooker::drainFrames() {
+    for (int i = 0; i < drainBatch; i++) {
+        if (!camera)
             return;
+        auto frame = camera->takeFrame();
+        if (!frame)
+            return;
+        emit frameDelivered(frame);
+        ingestFrame(frame);
+    }
+    // There may be more, but let queued calls from the GUI through first.
+    // The camera won't wake us up again until the ring has been emptied.
+    QMetaObject::invokeMethod(this, "drainFrames", Qt::QueuedConnection);
+}
+
+void Cooker::ingestFrame(QArvFramePtr rawFrame) {
+    receivedFrames.fetch_add(1, std::memory_order_relaxed);
+    if (!makeRoom()) {
+        droppedFrames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!params)
+        params = QSharedPointer<const Parameters>(new Parameters(p));
+    Job job;
+    job.rawFrame = rawFrame;
+    job.params = params;
+    job.render = doRender.exchange(false);
+    job.cooked = cookedWanted.load();
+    // Sensor-space filters only run on full frames, so they are rendered
+    // instead of previews, and calibrations are captured even while
+    // nothing else needs the frames.
+    bool sensorFiltering = false, filtersWantFrames = false;
+    for (auto filter : params->filterChain) {
+        if (filter->isEnabled()) {
+            sensorFiltering |= filter->isSensorSpace();
+            filtersWantFrames |= filter->wantsFrames();
         }
+    }
+    job.preview = job.render && params->previewDecoder && !sensorFiltering;
+    job.decode = (job.render && !job.preview) || job.cooked
+                 || filtersWantFrames
+                 || (params->recorder && !params->recorder->recordsRaw());
+    {
+        QMutexLocker l(&jobCountLock);
+        job.sequence = jobsStarted++;
+    }
+    // Only blocks with BlockStream, makeRoom() has made sure there is room
+    // otherwise.
+    decodeQueue.push(job);
+}
 
-        p.decoder->decode(frame);
-        cv::Mat img = p.decoder->getCvImage();
+/*
+ * Applies the drop policy if the pipeline is full, or if the decoding stage
+ * is behind and the decoding queue is full, which usually happens first.
+ * Only this thread pushes to the decoding queue, so if it has room now, the
+ * push that follows does not block. Returns false if the incoming frame is
+ * to be dropped.
+ */
+bool Cooker::makeRoom() {
+    QMutexLocker l(&jobCountLock);
+    const quint64 cap = maxInFlight;
+    if (dropPolicy == Workthread::BlockStream) {
+        while (jobsStarted - jobsFinished >= cap)
+            jobFinished.wait(&jobCountLock);
+        return true;
+    }
+    if (jobsStarted - jobsFinished < cap && !decodeQueue.isFull())
+        return true;
+    if (dropPolicy == Workthread::DropOldest) {
+        l.unlock();
+        // If every frame is already being worked on, the new one goes.
+        return dropOldest();
+    }
+    return false;
+}
 
-        if (p.imageTransform_invert) {
-            int bits = img.depth() == CV_8U ? 8 : 16;
-            cv::subtract((1 << bits) - 1, img, img);
-        }
+bool Cooker::dropOldest() {
+    Job oldest;
+    if (!decodeQueue.takeOldest(oldest))
+        return false;
+    droppedFrames.fetch_add(1, std::memory_order_relaxed);
+    // The renderer is waiting for this one.
+    if (oldest.render)
+        doRender.store(true);
+    if (workerCount > 1) {
+        // The frames after this one are still in the decoding queue, so
+        // nothing is released to the sink here and this does not block.
+        QMutexLocker l(&reorderLock);
+        droppedSequences.insert(oldest.sequence);
+        flushReorderBuffer(l);
+    }
+    finishJob();
+    return true;
+}
 
-        if (p.imageTransform_flip != -100)
-            cv::flip(img, img, p.imageTransform_flip);
+void Cooker::runStage(BoundedQueue<Job>& input, BoundedQueue<Job>* output,
+                      void (Cooker::*work)(Job&)) {
+    forever {
+        Job job;
+        if (!input.pop(job))
+            return;
+        (this->*work)(job);
+        if (output)
+            output->push(job);
+        else
+            finishJob();
+    }
+}
 
-        switch (p.imageTransform_rot) {
-        case 1:
-            cv::transpose(img, img);
-            cv::flip(img, img, 0);
+/*
+ * Decodes and transforms whole frames, using a decoder of its own, and
+ * passes them on through the reorder buffer.
+ */
+void Cooker::runWorker() {
+    QArvDecoder* decoder = nullptr, * previewDecoder = nullptr;
+    bool haveDecoder = false;
+    uint generation = 0;
+    forever {
+        {
+            // Don't run ahead of a slow frame without bound. The frame
+            // everybody waits for has already been taken by another worker.
+            QMutexLocker l(&reorderLock);
+            while (reorderBuffer.size() >= workerCount)
+                reorderSpace.wait(&reorderLock);
+        }
+        Job job;
+        if (!decodeQueue.pop(job))
             break;
 
-        case 2:
-            cv::flip(img, img, -1);
-            break;
+        QArvDecoder* shared = job.params->decoder;
+        if (shared && (!haveDecoder
+                       || generation != job.params->decoderGeneration)) {
+            delete decoder;
+            delete previewDecoder;
+            previewDecoder = nullptr;
+            QMutexLocker l(&sharedDecoderLock);
+            decoder = QArvDecoder::makeDecoder(shared->decoderSpecification());
+            if (auto preview = job.params->previewDecoder)
+                previewDecoder =
+                    QArvDecoder::makeDecoder(preview->decoderSpecification());
+            haveDecoder = true;
+            generation = job.params->decoderGeneration;
+        }
+        if (decoder) {
+            decodeWith(job, decoder, previewDecoder);
+        } else if (shared) {
+            // Decoders that cannot be instantiated again, such as the
+            // placeholder for unsupported formats, are used in turn.
+            QMutexLocker l(&sharedDecoderLock);
+            decodeWith(job, shared, job.params->previewDecoder);
+        }
+        transformFrame(job);
+
+        QMutexLocker l(&reorderLock);
+        reorderBuffer.insert(job.sequence, job);
+        flushReorderBuffer(l);
+    }
+    delete decoder;
+    delete previewDecoder;
+}
 
-        case 3:
-            cv::transpose(img, img);
-            cv::flip(img, img, 1);
+/*
+ * Passes on frames that are next in order. Call with reorderLock held by the
+ * given locker. The lock is released before the frames are pushed to the
+ * sink, which may block, so a slow sink does not hold up the others. Each
+ * batch of frames takes a ticket, so that the batches still reach the sink
+ * in order.
+ */
+void Cooker::flushReorderBuffer(QMutexLocker& reorderLocker) {
+    QList<Job> ready;
+    forever {
+        if (!reorderBuffer.isEmpty()
+            && reorderBuffer.firstKey() == nextSequence) {
+            ready << reorderBuffer.take(nextSequence);
+        } else if (!droppedSequences.remove(nextSequence)) {
             break;
         }
+        nextSequence++;
+    }
+    reorderDepth.store(reorderBuffer.size(), std::memory_order_relaxed);
+    reorderSpace.wakeAll();
+    if (ready.isEmpty())
+        return;
+    const quint64 ticket = flushTickets++;
+    reorderLocker.unlock();
+
+    QMutexLocker l(&sinkOrderLock);
+    while (ticket != nextFlushTicket)
+        sinkTurn.wait(&sinkOrderLock);
+    foreach (const auto& job, ready)
+        sinkQueue.push(job);
+    nextFlushTicket++;
+    sinkTurn.wakeAll();
+}
+
+void Cooker::finishJob() {
+    QMutexLocker l(&jobCountLock);
+    jobsFinished++;
+    jobFinished.wakeAll();
+}
+
+// Waits until all frames that have entered the pipeline so far are done.
+void Cooker::waitForPipeline() {
+    QMutexLocker l(&jobCountLock);
+    const quint64 target = jobsStarted;
+    while (jobsFinished < target)
+        jobFinished.wait(&jobCountLock);
+}
 
-        bool needFiltering = false;
-        for (auto filter : qAsConst(p.filterChain)) {
-            if (filter->isEnabled()) {
+void Cooker::decodeFrame(Job& job) {
+    decodeWith(job, job.params->decoder, job.params->previewDecoder);
+}
+
+void Cooker::decodeWith(Job& job, QArvDecoder* decoder,
+                        QArvDecoder* previewDecoder) {
+    if (!decoder)
+        return;
+    const QByteArray frame = job.rawFrame->data();
+    if (frame.isEmpty()) {
+        job.invalid = true;
+        return;
+    }
+    if (job.preview && !previewDecoder) {
+        job.preview = false;
+        job.decode = true;
+    }
+    if (job.decode)
+        job.image = decodeImage(frame, decoder);
+    if (job.preview)
+        job.previewImage = decodeImage(frame, previewDecoder);
+}
+
+// Decodes straight into a pooled image. Decoders that do not know the type
+// of their images in advance, such as the placeholder for unsupported
+// formats, allocate it themselves.
+cv::Mat Cooker::decodeImage(const QByteArray& frame, QArvDecoder* decoder) {
+    cv::Mat image;
+    const int type = decoder->cvType();
+    if (type >= 0) {
+        const QSize size = decoder->imageSize();
+        image = images.take(size.height(), size.width(), type);
+    }
+    decoder->decodeInto(frame, image);
+    return image;
+}
+
+void Cooker::transformFrame(Job& job) {
+    const Parameters& jp = *job.params;
+    if (!jp.decoder || job.invalid)
+        return;
+    if (!job.image.empty())
+        transformImage(jp, job.image);
+    if (!job.previewImage.empty())
+        transformImage(jp, job.previewImage, false);
+}
+
+/*
+ * Calibrations refer to sensor pixels, so sensor-space filters come first.
+ * Preview images do not cover the sensor pixel for pixel, so they skip
+ * them.
+ */
+void Cooker::transformImage(const Parameters& jp, cv::Mat& img,
+                            bool sensorFilters) {
+    const int imageType = img.type();
+    bool needSensorFiltering = false, needFiltering = false;
+    for (auto filter : jp.filterChain) {
+        if (filter->isEnabled()) {
+            if (filter->isSensorSpace())
+                needSensorFiltering = sensorFilters;
+            else
                 needFiltering = true;
-                break;
-            }
-        }
-        if (!needFiltering) {
-            processedFrame = img;
-        } else {
-            img = img.clone();
-            int imageType = img.type();
-            for (auto filter : qAsConst(p.filterChain)) {
-                if (filter->isEnabled())
-                    filter->filterImage(img);
-            }
-            img.convertTo(processedFrame, imageType);
         }
     }
+    if (needSensorFiltering)
+        ImageFilter::filterChain(jp.filterChain, img, true);
 
-    if (p.recorder && p.recorder->isOK()) {
-        if (maxRecordedFrames == 0 || recordedFrames < maxRecordedFrames) {
+    const ImageTransform& transform = jp.imageTransform;
+    if (transform.isInPlace()) {
+        if (!transform.isIdentity())
+            transform.apply(img, img);
+    } else {
+        const cv::Size size = transform.outputSize(img.size());
+        cv::Mat transformed = images.take(size.height, size.width,
+                                          img.type());
+        transform.apply(img, transformed);
+        img = transformed;
+    }
+
+    if (needFiltering)
+        ImageFilter::filterChain(jp.filterChain, img);
+    if (img.type() != imageType) {
+        cv::Mat converted = images.take(img.rows, img.cols, imageType);
+        img.convertTo(converted, imageType);
+        img = converted;
+    }
+}
+
+void Cooker::sinkFrame(Job& job) {
+    const Parameters& jp = *job.params;
+    if (jp.decoder && job.invalid) {
+        if (job.cooked)
+            emit frameCooked(cv::Mat());
+        if (job.render)
+            emit frameToRender(cv::Mat());
+        return;
+    }
+
+    if (jp.recordingEpoch != recordingEpoch) {
+        recordingEpoch = jp.recordingEpoch;
+        recordedFrames = 0;
+    }
+    if (jp.recorder && jp.recorder->isOK()) {
+        if (jp.maxRecordedFrames == 0
+            || recordedFrames < jp.maxRecordedFrames) {
             recordedFrames++;
-            if (p.recorder->recordsRaw())
-                p.recorder->recordFrame(frame);
+            if (jp.recorder->recordsRaw())
+                jp.recorder->recordFrame(job.rawFrame->data());
             else
-                p.recorder->recordFrame(processedFrame);
-            if (p.timestampFile && p.timestampFile->isOpen()) {
-                quint64 ts;
-#ifdef ARAVIS_OLD_BUFFER
-                ts = aravisFrame->timestamp_ns;
-#else
-                ts = arv_buffer_get_timestamp(aravisFrame);
-#endif
-                p.timestampFile->write(QString::number(ts).toLatin1());
-                p.timestampFile->write("\n");
+                jp.recorder->recordFrame(job.image);
+            if (jp.timestampFile && jp.timestampFile->isOpen()) {
+                jp.timestampFile->write(
+                    QString::number(job.rawFrame->meta().timestamp).toLatin1());
+                jp.timestampFile->write("\n");
             }
         } else {
             emit recordingStopped();
         }
     }
 
-    emit frameCooked(processedFrame.clone());
-    if (doRender.load()) {
-        doRender.store(false);
-        emit frameToRender(processedFrame.clone());
-    }
+    // The image is not touched by the pipeline any more, so it can be
+    // shared. It returns to the pool when all receivers are done with it.
+    if (job.cooked)
+        emit frameCooked(job.image);
+    if (job.render)
+        emit frameToRender(job.preview ? job.previewImage : job.image);
 }
 
 void Cooker::setImageTransform(bool imageTransform_invert,
                                int imageTransform_flip,
                                int imageTransform_rot) {
-    p.imageTransform_invert = imageTransform_invert;
-    p.imageTransform_flip = imageTransform_flip;
-    p.imageTransform_rot = imageTransform_rot;
+    p.imageTransform = ImageTransform(imageTransform_invert,
+                                      imageTransform_flip,
+                                      imageTransform_rot);
+    params.clear();
 }
 
 void QArv::Cooker::setFilterChain(QVector<QArv::ImageFilterPtr> filterChain) {
     p.filterChain = filterChain;
+    params.clear();
 }
 
 void Cooker::setRecorder(Recorder* recorder, QFile* timestampFile,
@@ -308,9 +682,10 @@ void Cooker::setRecorder(Recorder* recorder, QFile* timestampFile,
     p.recorder = recorder;
     p.timestampFile = timestampFile;
     if (maxFrames != -1) {
-        maxRecordedFrames = maxFrames;
-        recordedFrames = 0;
+        p.maxRecordedFrames = maxFrames;
+        p.recordingEpoch++;
     }
+    params.clear();
 }
 
 void Cooker::getFps(uint* fps) {
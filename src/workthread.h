@@ -18,16 +18,41 @@
  */
 
 /*
- * The worker threads serve only to keep the GUI responsive. There are
- * no resources that are "really" shared, e.g. the decoder is only ever used
- * in the Cooker thread so there is no chance of a race. These resources are
- * only freed in the main thread after the work is complete.
+ * The worker threads serve to keep the GUI responsive and to spread frame
+ * processing over several cores. The Cooker thread only takes frames from the
+ * camera. Each frame then passes through three stages, each in its own
+ * thread: decoding, image transformation and filtering, and the sink, which
+ * records the frame and hands it to the Renderer and other consumers. The
+ * stages are connected by short bounded queues, so the frame rate is limited
+ * by the slowest stage rather than by their sum, and a slow stage eventually
+ * stalls the Cooker, leaving frames in the camera's queue.
+ *
+ * The number of frames in the pipeline is capped. When the cap is reached,
+ * or the decoding queue is full, the Cooker either waits, or drops the
+ * newest or the oldest waiting frame, see Workthread::setDropPolicy().
+ *
+ * Alternatively, decoding and transformation can be done by several worker
+ * threads, each of which takes whole frames. Their results go through a
+ * reorder buffer so that the sink still sees frames in acquisition order.
+ * Each worker has its own instance of the decoder.
+ *
+ * Every frame carries an immutable snapshot of the processing parameters
+ * taken when it entered the pipeline, so the stages never see parameters
+ * change under them. The decoder is only ever used by the decoding stage.
+ * Resources such as the decoder and the recorder are only freed in the main
+ * thread after the pipeline has been drained, see
+ * waitUntilProcessingCycleCompletes().
  *
  * Exceptions: the camera lives in the Cooker's thread in order to deliver
- * signals completely bypassing the GUI thread. Apart from its signals and
+ * frames completely bypassing the GUI thread. Apart from its signals and
  * acqusition control, its functions should be safe to use from the GUI thread
  * because signals are the only thing it needs event loop for. Calls that need
  * to be threadsafe are implemented via Workthread and Cooker.
+ *
+ * Frames do not travel from the camera to the Cooker as signals. The camera
+ * puts them on a lock-free ring straight from the Aravis stream thread and
+ * only wakes the Cooker up when it has run out of work, see
+ * QArvCamera::setFrameRingDelivery().
  */
 
 #ifndef WORKTHREAD_H
@@ -35,9 +60,14 @@
 
 #include "filters/filter.h"
 #include "api/qarvcamera.h"
+#include "pipeline.h"
+#include "matpool.h"
+#include "imagetransform.h"
 #include <QImage>
 #include <QFile>
 #include <QElapsedTimer>
+#include <QMap>
+#include <QSet>
 #include <opencv2/core/core.hpp>
 #include <functional>
 
@@ -55,16 +85,40 @@ class Cooker : public QObject {
     Q_OBJECT
 
     friend class Workthread;
+    friend class CookerTest;
     explicit Cooker(QObject* parent = 0);
+    ~Cooker();
 
     struct Parameters {
-        bool imageTransform_invert = false;
-        int imageTransform_flip = 0;
-        int imageTransform_rot = 0;
+        ImageTransform imageTransform;
         QVector<ImageFilterPtr> filterChain;
         QArvDecoder* decoder = nullptr;
+        // If set, used for frames that are only rendered.
+        QArvDecoder* previewDecoder = nullptr;
         QFile* timestampFile = nullptr;
         Recorder* recorder = nullptr;
+        int maxRecordedFrames = 0;
+        // Incremented whenever the recorded frame count is to be reset.
+        uint recordingEpoch = 0;
+        // Incremented whenever the decoder is replaced.
+        uint decoderGeneration = 0;
+    };
+
+    // A frame on its way through the pipeline.
+    struct Job {
+        quint64 sequence = 0;
+        QArvFramePtr rawFrame;
+        QSharedPointer<const Parameters> params;
+        cv::Mat image;
+        bool invalid = false;
+        bool render = false;
+        // Whether anybody needs decoded pixels of this frame, and whether
+        // they should be sent out with frameCooked().
+        bool decode = false;
+        bool cooked = false;
+        // Whether the renderer gets previewImage instead of image.
+        bool preview = false;
+        cv::Mat previewImage;
     };
 
 private slots:
@@ -75,7 +129,7 @@ private slots:
     void cameraAcquisition(QArvCamera* camera, bool start,
                            bool zeroCopy, bool dropInvalidFrames);
 
-    void processFrame(QByteArray frame, ArvBuffer* aravisFrame);
+    void drainFrames();
 
     void setImageTransform(bool imageTransform_invert,
                            int imageTransform_flip,
@@ -87,20 +141,82 @@ private slots:
                      QFile* timestampFile,
                      int maxFrames);
 
+    void setWorkerCount(int workers);
+
+    void setDropPolicy(int policy, int maxInFlight);
+
 signals:
+    void frameDelivered(QArvFramePtr frame);
     void frameCooked(cv::Mat frame);
     void frameToRender(cv::Mat frame);
     void recordingStopped();
 
 private:
+    void ingestFrame(QArvFramePtr rawFrame);
+    bool makeRoom();
+    bool dropOldest();
+    void decodeFrame(Job& job);
+    void decodeWith(Job& job, QArvDecoder* decoder,
+                    QArvDecoder* previewDecoder);
+    cv::Mat decodeImage(const QByteArray& frame, QArvDecoder* decoder);
+    void transformFrame(Job& job);
+    void transformImage(const Parameters& jp, cv::Mat& img,
+                        bool sensorFilters = true);
+    void sinkFrame(Job& job);
+    void runStage(BoundedQueue<Job>& input, BoundedQueue<Job>* output,
+                  void (Cooker::*work)(Job&));
+    void runWorker();
+    void flushReorderBuffer(QMutexLocker& reorderLocker);
+    void startStages(int workers);
+    void stopStages();
+    void finishJob();
+    void waitForPipeline();
     void getFps(uint* fps);
 
+    QArvCamera* camera = nullptr;
+    // Modified only by the Cooker thread; frames get a copy in params.
     Parameters p;
-    cv::Mat processedFrame;
+    QSharedPointer<const Parameters> params;
     std::atomic_bool doRender;
-    int maxRecordedFrames;
-    int recordedFrames;
+    // Whether anything is connected to Workthread::frameCooked().
+    std::atomic_bool cookedWanted;
     std::atomic<uint> receivedFrames;
+    std::atomic<quint64> droppedFrames;
+    int dropPolicy;
+    int maxInFlight = 16;
+
+    BoundedQueue<Job> decodeQueue, transformQueue, sinkQueue;
+    // Decoded images, shared by all stages.
+    MatPool images;
+    QList<StageThread*> stages;
+    int workerCount = 1;
+
+    // Used only with more than one worker.
+    QMutex reorderLock;
+    QWaitCondition reorderSpace;
+    QMap<quint64, Job> reorderBuffer;
+    // Frames dropped before a worker got to them.
+    QSet<quint64> droppedSequences;
+    quint64 nextSequence = 0;
+    // Frames in the reorder buffer, for Workthread::getQueueDepths().
+    std::atomic<int> reorderDepth { 0 };
+    // Batches of frames released by the reorder buffer take tickets under
+    // reorderLock and are pushed to the sink in ticket order.
+    quint64 flushTickets = 0;
+    QMutex sinkOrderLock;
+    QWaitCondition sinkTurn;
+    quint64 nextFlushTicket = 0;
+    // Serializes the shared decoder when it cannot be instantiated per worker.
+    QMutex sharedDecoderLock;
+    // Frames that entered the pipeline and frames that left it.
+    QMutex jobCountLock;
+    QWaitCondition jobFinished;
+    quint64 jobsStarted = 0, jobsFinished = 0;
+
+    // Used only by the sink stage.
+    int recordedFrames = 0;
+    uint recordingEpoch = 0;
+
     uint lastFpsRequestFrames;
     QElapsedTimer lastFpsRequest;
 };
@@ -134,8 +250,11 @@ public:
 
     // Replaces the old camera with the new one. After that, the old
     // camera can be deleted. The new camera can be NULL, and so can the
-    // decoder.
-    void newCamera(QArvCamera* camera, QArvDecoder* decoder);
+    // decoders. If there is a preview decoder, it is used instead of the
+    // regular one for the images sent to the renderer, unless sensor-space
+    // filters are enabled; everybody else still gets full images.
+    void newCamera(QArvCamera* camera, QArvDecoder* decoder,
+                   QArvDecoder* previewDecoder = nullptr);
 
     // Can be NULL.
     void newRecorder(Recorder* recorder, QFile* timestampFile);
@@ -165,13 +284,59 @@ public:
 
     uint getFps();
 
+    enum DropPolicy {
+        // Stop taking frames from the camera until there is room. Frames
+        // pile up in the camera's buffers and are lost there when it runs
+        // out of them.
+        BlockStream,
+        // Drop incoming frames.
+        DropNewest,
+        // Drop the oldest frame not being processed yet.
+        DropOldest,
+    };
+
+    // maxInFlight: the largest number of frames in the pipeline at once,
+    //   including the ones being processed. Should be at least the number
+    //   of workers plus one. The drop policy also applies when the queue
+    //   in front of the decoding stage is full, which holds a few frames.
+    void setDropPolicy(DropPolicy policy, int maxInFlight);
+
+    // Number of frames dropped by the drop policy since the camera was
+    // started. Frames lost by the camera itself are not counted.
+    quint64 getDroppedFrames();
+
+    // workers: if 1, decoding and transformation run in separate threads,
+    //   one frame at a time each; if more, each of this many threads takes
+    //   whole frames. Takes effect immediately, but the pipeline is drained
+    //   first, so it is best changed while the camera is stopped.
+    void setWorkerCount(int workers);
+
+    // Number of frames waiting in front of each pipeline stage. With several
+    // workers, transform is always zero and reorder counts the frames that
+    // are done but wait for an earlier frame.
+    struct QueueDepths {
+        int decode = 0;
+        int transform = 0;
+        int reorder = 0;
+        int sink = 0;
+    };
+    QueueDepths getQueueDepths();
+
 signals:
-    void frameDelivered(QByteArray frame, ArvBuffer* arvFrame);
+    void frameDelivered(QArvFramePtr frame);
+    // Frames are only decoded for this signal while something is connected.
+    // The image is shared with other receivers and must not be modified.
     void frameCooked(cv::Mat frame);
     void frameRendered();
     void recordingStopped();
 
+protected:
+    void connectNotify(const QMetaMethod& signal) override;
+    void disconnectNotify(const QMetaMethod& signal) override;
+
 private:
+    void updateConsumers();
+
     QArvCamera* camera = nullptr;
     Recorder* recorder = nullptr;
     QFile* timestampFile = nullptr;
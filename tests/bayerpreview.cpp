@@ -0,0 +1,93 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "api/qarvdecoder.h"
+#include <QtTest>
+extern "C" {
+  #include <arv.h>
+}
+
+// Checks that the superpixel preview takes each color from the right site.
+class BayerPreviewTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void channelOrder_data();
+    void channelOrder();
+};
+
+void BayerPreviewTest::channelOrder_data() {
+    QTest::addColumn<quint32>("format");
+    QTest::addColumn<int>("redRow");
+    QTest::addColumn<int>("redColumn");
+    QTest::newRow("RG8") << quint32(ARV_PIXEL_FORMAT_BAYER_RG_8) << 0 << 0;
+    QTest::newRow("GR8") << quint32(ARV_PIXEL_FORMAT_BAYER_GR_8) << 0 << 1;
+    QTest::newRow("GB8") << quint32(ARV_PIXEL_FORMAT_BAYER_GB_8) << 1 << 0;
+    QTest::newRow("BG8") << quint32(ARV_PIXEL_FORMAT_BAYER_BG_8) << 1 << 1;
+#ifdef ARV_PIXEL_FORMAT_BAYER_GR_16
+    QTest::newRow("RG16") << quint32(ARV_PIXEL_FORMAT_BAYER_RG_16) << 0 << 0;
+    QTest::newRow("GR16") << quint32(ARV_PIXEL_FORMAT_BAYER_GR_16) << 0 << 1;
+    QTest::newRow("GB16") << quint32(ARV_PIXEL_FORMAT_BAYER_GB_16) << 1 << 0;
+    QTest::newRow("BG16") << quint32(ARV_PIXEL_FORMAT_BAYER_BG_16) << 1 << 1;
+#endif
+}
+
+void BayerPreviewTest::channelOrder() {
+    QFETCH(quint32, format);
+    QFETCH(int, redRow);
+    QFETCH(int, redColumn);
+    const QSize size(8, 6);
+    QScopedPointer<QArvDecoder> decoder(
+        QArvDecoder::makePreviewDecoder(format, size));
+    QVERIFY(decoder);
+    const bool wide = CV_MAT_DEPTH(decoder->cvType()) == CV_16U;
+    const int unit = wide ? 256 : 1;
+    const int red = 200 * unit, green = 100 * unit, blue = 50 * unit;
+
+    cv::Mat mosaic(size.height(), size.width(), wide ? CV_16UC1 : CV_8UC1);
+    for (int y = 0; y < mosaic.rows; y++) {
+        for (int x = 0; x < mosaic.cols; x++) {
+            const bool r = y % 2 == redRow, c = x % 2 == redColumn;
+            const int value = r && c ? red : !r && !c ? blue : green;
+            if (wide)
+                mosaic.at<ushort>(y, x) = value;
+            else
+                mosaic.at<uchar>(y, x) = value;
+        }
+    }
+    QByteArray frame(reinterpret_cast<const char*>(mosaic.data),
+                     mosaic.total() * mosaic.elemSize());
+    decoder->decode(frame);
+
+    cv::Mat image;
+    decoder->getCvImage().convertTo(image, CV_32SC3);
+    QCOMPARE(image.rows, size.height() / 2);
+    QCOMPARE(image.cols, size.width() / 2);
+    for (int y = 0; y < image.rows; y++) {
+        for (int x = 0; x < image.cols; x++) {
+            const cv::Vec3i bgr = image.at<cv::Vec3i>(y, x);
+            QCOMPARE(bgr[0], blue);
+            QCOMPARE(bgr[1], green);
+            QCOMPARE(bgr[2], red);
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(BayerPreviewTest)
+#include "bayerpreview.moc"
@@ -0,0 +1,253 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filters/flatfield.h"
+#include "filters/defectivepixels.h"
+#include <QTemporaryDir>
+#include <QtTest>
+
+using namespace QArv;
+
+namespace
+{
+
+/*
+ * A 16-bit frame from a sensor with a dark level that rises to the right
+ * and a response that varies across the sensor.
+ */
+cv::Mat sensorFrame(double exposure) {
+    cv::Mat frame(4, 6, CV_16UC1);
+    for (int y = 0; y < frame.rows; y++) {
+        for (int x = 0; x < frame.cols; x++) {
+            const double dark = 1000 + 10 * x;
+            const double response = 1 + 0.1 * y - 0.05 * x;
+            frame.at<ushort>(y, x) = cv::saturate_cast<ushort>(
+                dark + exposure * response);
+        }
+    }
+    return frame;
+}
+
+void feed(ImageFilter& filter, double exposure, int frames) {
+    for (int i = 0; i < frames; i++) {
+        cv::Mat frame = sensorFrame(exposure);
+        filter.filterImage(frame);
+    }
+}
+
+// Whether all samples are within the given distance of each other.
+bool isFlat(const cv::Mat& image, double tolerance) {
+    double min, max;
+    cv::minMaxIdx(image, &min, &max);
+    return max - min <= tolerance;
+}
+
+}
+
+class CalibrationFiltersTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void frameAverager();
+    void flatField();
+    void flatFieldBeforeDark();
+    void flatFieldFile();
+    void flatFieldResave();
+    void flatFieldMismatch();
+    void defectivePixels();
+    void defectivePixelsDetection();
+    void defectivePixelsFile();
+};
+
+void CalibrationFiltersTest::frameAverager() {
+    FrameAverager averager;
+    QVERIFY(averager.add(cv::Mat(2, 2, CV_8UC1, cv::Scalar(1))).empty());
+    averager.start(2);
+    QVERIFY(averager.add(cv::Mat(2, 2, CV_8UC1, cv::Scalar(1))).empty());
+    // A frame of another size starts the average over.
+    QVERIFY(averager.add(cv::Mat(3, 2, CV_16UC3, cv::Scalar(2))).empty());
+    QCOMPARE(averager.remaining(), 1);
+    const cv::Mat mean = averager.add(cv::Mat(3, 2, CV_16UC3,
+                                              cv::Scalar(5)));
+    QCOMPARE(averager.remaining(), 0);
+    QCOMPARE(mean.type(), CV_64FC3);
+    QCOMPARE(mean.size(), cv::Size(2, 3));
+    QCOMPARE(cv::mean(mean), cv::Scalar(3.5, 3.5, 3.5));
+}
+
+void CalibrationFiltersTest::flatField() {
+    FlatFieldFilter filter(nullptr);
+    filter.capture(FlatFieldFilter::Dark, 2);
+    feed(filter, 0, 2);
+    QCOMPARE(filter.captureRemaining(), 0);
+    filter.capture(FlatFieldFilter::Flat, 2);
+    feed(filter, 20000, 2);
+    QCOMPARE(filter.captureRemaining(), 0);
+
+    cv::Mat dark = sensorFrame(0);
+    filter.filterImage(dark);
+    QVERIFY(!filter.mismatched());
+    QCOMPARE(cv::countNonZero(dark), 0);
+
+    // The response averages to 1.025 over the frame, and that is kept.
+    cv::Mat image = sensorFrame(10000);
+    filter.filterImage(image);
+    QVERIFY(isFlat(image, 2));
+    QVERIFY(qAbs(cv::mean(image)[0] - 10250) < 2);
+}
+
+void CalibrationFiltersTest::flatFieldBeforeDark() {
+    FlatFieldFilter filter(nullptr);
+    filter.capture(FlatFieldFilter::Flat, 1);
+    feed(filter, 20000, 1);
+    filter.capture(FlatFieldFilter::Dark, 1);
+    feed(filter, 0, 1);
+
+    // The gain follows the dark map captured after the flat frame.
+    cv::Mat image = sensorFrame(10000);
+    filter.filterImage(image);
+    QVERIFY(isFlat(image, 2));
+    QVERIFY(qAbs(cv::mean(image)[0] - 10250) < 2);
+}
+
+void CalibrationFiltersTest::flatFieldFile() {
+    FlatFieldFilter filter(nullptr);
+    filter.capture(FlatFieldFilter::Dark, 1);
+    feed(filter, 0, 1);
+    filter.capture(FlatFieldFilter::Flat, 1);
+    feed(filter, 20000, 1);
+
+    QTemporaryDir dir;
+    const QString name = dir.filePath("calibration");
+    QVERIFY(filter.save(name));
+    FlatFieldFilter loaded(nullptr);
+    QVERIFY(loaded.load(name));
+    QCOMPARE(loaded.fileName(), name);
+
+    cv::Mat a = sensorFrame(10000), b = a.clone();
+    filter.filterImage(a);
+    loaded.filterImage(b);
+    QCOMPARE(cv::countNonZero(a != b), 0);
+
+    QFile broken(dir.filePath("broken"));
+    QVERIFY(broken.open(QIODevice::WriteOnly));
+    broken.write("QARVFLAT");
+    broken.close();
+    QVERIFY(!loaded.load(broken.fileName()));
+}
+
+void CalibrationFiltersTest::flatFieldResave() {
+    FlatFieldFilter filter(nullptr);
+    filter.capture(FlatFieldFilter::Dark, 1);
+    feed(filter, 0, 1);
+    filter.capture(FlatFieldFilter::Flat, 1);
+    feed(filter, 20000, 1);
+    QTemporaryDir dir;
+    const QString name = dir.filePath("calibration");
+    QVERIFY(filter.save(name));
+
+    // A new dark map replaces one of the maps mapped from the file, and
+    // saving it over that file must not lose it.
+    FlatFieldFilter loaded(nullptr);
+    QVERIFY(loaded.load(name));
+    loaded.capture(FlatFieldFilter::Dark, 1);
+    feed(loaded, 500, 1);
+    QVERIFY(loaded.save(name));
+    FlatFieldFilter reloaded(nullptr);
+    QVERIFY(reloaded.load(name));
+
+    cv::Mat a = sensorFrame(10000), b = a.clone();
+    loaded.filterImage(a);
+    reloaded.filterImage(b);
+    QCOMPARE(cv::countNonZero(a != b), 0);
+    cv::Mat dark = sensorFrame(500);
+    reloaded.filterImage(dark);
+    QCOMPARE(cv::countNonZero(dark), 0);
+}
+
+void CalibrationFiltersTest::flatFieldMismatch() {
+    FlatFieldFilter filter(nullptr);
+    filter.capture(FlatFieldFilter::Dark, 1);
+    feed(filter, 0, 1);
+    cv::Mat other(3, 6, CV_16UC1, cv::Scalar(5000));
+    filter.filterImage(other);
+    QVERIFY(filter.mismatched());
+    QCOMPARE(other.at<ushort>(0, 0), ushort(5000));
+}
+
+void CalibrationFiltersTest::defectivePixels() {
+    DefectivePixelsFilter filter(nullptr);
+    // A corner, two neighbours, and one outside of the image.
+    filter.setDefects({ QPoint(0, 0), QPoint(2, 2), QPoint(3, 2),
+                        QPoint(10, 10) });
+    cv::Mat image(5, 5, CV_16UC3, cv::Scalar(100, 200, 300));
+    image.at<cv::Vec3w>(0, 0) = cv::Vec3w(65535, 0, 65535);
+    image.at<cv::Vec3w>(2, 2) = cv::Vec3w(0, 0, 0);
+    image.at<cv::Vec3w>(2, 3) = cv::Vec3w(65535, 65535, 65535);
+    image.at<cv::Vec3w>(4, 4) = cv::Vec3w(7, 8, 9);
+    filter.filterImage(image);
+    for (auto p : { QPoint(0, 0), QPoint(2, 2), QPoint(3, 2) })
+        QCOMPARE(image.at<cv::Vec3w>(p.y(), p.x()), cv::Vec3w(100, 200, 300));
+    // Pixels that are not listed stay as they are.
+    QCOMPARE(image.at<cv::Vec3w>(4, 4), cv::Vec3w(7, 8, 9));
+}
+
+void CalibrationFiltersTest::defectivePixelsDetection() {
+    DefectivePixelsFilter filter(nullptr);
+    filter.detect(2, 0.1);
+    for (int i = 0; i < 2; i++) {
+        cv::Mat frame(8, 8, CV_16UC1, cv::Scalar(1000 + i));
+        frame.at<ushort>(4, 3) = 65535;
+        frame.at<ushort>(6, 6) = 1100;
+        filter.filterImage(frame);
+    }
+    QCOMPARE(filter.detectRemaining(), 0);
+    auto defects = filter.defects();
+    QVERIFY(defects);
+    QCOMPARE(*defects, DefectivePixelsFilter::Defects { QPoint(3, 4) });
+}
+
+void CalibrationFiltersTest::defectivePixelsFile() {
+    QTemporaryDir dir;
+    const QString name = dir.filePath("defects.txt");
+    QFile file(name);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("# Vendor list\n1 2\n\n\t30  40 # hot\n");
+    file.close();
+
+    DefectivePixelsFilter filter(nullptr);
+    QVERIFY(filter.load(name));
+    const DefectivePixelsFilter::Defects expected { QPoint(1, 2),
+                                                   QPoint(30, 40) };
+    QCOMPARE(*filter.defects(), expected);
+
+    const QString copy = dir.filePath("copy.txt");
+    QVERIFY(filter.save(copy));
+    DefectivePixelsFilter reloaded(nullptr);
+    QVERIFY(reloaded.load(copy));
+    QCOMPARE(*reloaded.defects(), expected);
+
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("1 two\n");
+    file.close();
+    QVERIFY(!reloaded.load(name));
+}
+
+QTEST_GUILESS_MAIN(CalibrationFiltersTest)
+#include "calibrationfilters.moc"
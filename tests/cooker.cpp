@@ -0,0 +1,179 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "workthread.h"
+#include "pipeline.h"
+#include "api/qarvdecoder.h"
+#include <QSemaphore>
+#include <QtTest>
+#include <atomic>
+
+namespace QArv
+{
+
+// A decoder that holds up the decoding stage until it is let through.
+class GateDecoder : public QArvDecoder {
+public:
+    GateDecoder(QSemaphore& gate_) : gate(gate_) {}
+
+    void decode(QByteArray frame) override {
+        cv::Mat image;
+        decodeInto(frame, image);
+    }
+
+    void decodeInto(QByteArray frame, cv::Mat& image, QRect roi) override {
+        gate.acquire();
+        image.create(1, 1, CV_8UC1);
+        last.store(uchar(frame[0]));
+        decoded.fetch_add(1);
+    }
+
+    const cv::Mat getCvImage() override { return cv::Mat(1, 1, CV_8UC1); }
+    QSize imageSize() override { return QSize(1, 1); }
+    int cvType() override { return CV_8UC1; }
+    ArvPixelFormat pixelFormat() override { return 0; }
+    QByteArray decoderSpecification() override { return QByteArray(); }
+
+    QSemaphore& gate;
+    std::atomic<int> last { -1 };
+    std::atomic<int> decoded { 0 };
+};
+
+// Keeps a copy of the image it gets.
+class ProbeFilter : public ImageFilter {
+public:
+    ProbeFilter(bool sensorSpace_) : ImageFilter(nullptr),
+        sensorSpace(sensorSpace_) {
+        setEnabled(true);
+    }
+
+    ImageFilterSettingsWidget* createSettingsWidget() override {
+        return nullptr;
+    }
+    void restoreSettings() override {}
+    void saveSettings() override {}
+    void filterImage(cv::Mat& image) override { seen = image.clone(); }
+    bool isSensorSpace() override { return sensorSpace; }
+    bool wantsFrames() override { return wanting.load(); }
+
+    const bool sensorSpace;
+    std::atomic<bool> wanting { false };
+    cv::Mat seen;
+};
+
+class CookerTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void dropNewest() { flood(Workthread::DropNewest); }
+    void dropOldest() { flood(Workthread::DropOldest); }
+    void sensorSpaceFilters();
+    void filtersWantingFrames();
+
+private:
+    void flood(int policy);
+};
+
+/*
+ * Floods the Cooker with frames while the decoding stage is stuck. With a
+ * drop policy, the frames must be dropped instead of blocking the thread
+ * that delivers them.
+ */
+void CookerTest::flood(int policy) {
+    const int frames = 100;
+    QSemaphore gate;
+    GateDecoder decoder(gate);
+    Cooker cooker;
+    cooker.setDropPolicy(policy, 16);
+    cooker.p.decoder = &decoder;
+    cooker.cookedWanted.store(true);
+
+    StageThread producer([&] () {
+        for (int i = 0; i < frames; i++)
+            cooker.ingestFrame(QArvFramePtr(
+                new QArvFrame(QByteArray(1, char(i)))));
+    });
+    producer.start();
+    const bool finished = producer.wait(5000);
+    gate.release(frames);
+    producer.wait();
+    cooker.waitForPipeline();
+
+    QVERIFY2(finished, "The Cooker blocked instead of dropping frames.");
+    const int dropped = cooker.droppedFrames.load();
+    QVERIFY(dropped > 0);
+    QCOMPARE(decoder.decoded.load() + dropped, frames);
+    if (policy == Workthread::DropOldest)
+        QCOMPARE(decoder.last.load(), frames - 1);
+    else
+        QVERIFY(decoder.last.load() < frames - 1);
+}
+
+/*
+ * Sensor-space filters must see the image as decoded, even when they come
+ * later in the chain, while the others see it transformed.
+ */
+void CookerTest::sensorSpaceFilters() {
+    auto other = new ProbeFilter(false);
+    auto sensor = new ProbeFilter(true);
+    Cooker::Parameters jp;
+    jp.imageTransform = ImageTransform(true, 1);
+    jp.filterChain << ImageFilterPtr(other) << ImageFilterPtr(sensor);
+    cv::Mat image = (cv::Mat_<uchar>(1, 2) << 10, 20);
+    Cooker cooker;
+    cooker.transformImage(jp, image);
+    QCOMPARE(sensor->seen.at<uchar>(0, 0), uchar(10));
+    QCOMPARE(sensor->seen.at<uchar>(0, 1), uchar(20));
+    QCOMPARE(other->seen.at<uchar>(0, 0), uchar(235));
+    QCOMPARE(other->seen.at<uchar>(0, 1), uchar(245));
+
+    // Preview images skip them.
+    sensor->seen.release();
+    cooker.transformImage(jp, image, false);
+    QVERIFY(sensor->seen.empty());
+}
+
+/*
+ * Frames are decoded for a filter that wants them, such as one capturing
+ * a calibration, even when nothing else needs them.
+ */
+void CookerTest::filtersWantingFrames() {
+    QSemaphore gate;
+    GateDecoder decoder(gate);
+    auto filter = new ProbeFilter(true);
+    filter->wanting.store(true);
+    Cooker cooker;
+    cooker.p.decoder = &decoder;
+    cooker.p.filterChain << ImageFilterPtr(filter);
+    gate.release(1);
+    cooker.ingestFrame(QArvFramePtr(new QArvFrame(QByteArray(1, char(1)))));
+    cooker.waitForPipeline();
+    QCOMPARE(decoder.decoded.load(), 1);
+    QVERIFY(!filter->seen.empty());
+
+    filter->wanting.store(false);
+    cooker.ingestFrame(QArvFramePtr(new QArvFrame(QByteArray(1, char(2)))));
+    cooker.waitForPipeline();
+    QCOMPARE(decoder.decoded.load(), 1);
+}
+
+}
+
+QTEST_GUILESS_MAIN(QArv::CookerTest)
+#include "cooker.moc"
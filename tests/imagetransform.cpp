@@ -0,0 +1,122 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "imagetransform.h"
+#include <QtTest>
+
+using namespace QArv;
+
+namespace
+{
+
+// The transformation as it was done before ImageTransform, one step at a time.
+cv::Mat reference(const cv::Mat& input, bool invert, int flip, int rot) {
+    cv::Mat img = input.clone();
+    if (invert) {
+        const int bits = img.depth() == CV_8U ? 8 : 16;
+        cv::subtract(cv::Scalar::all((1 << bits) - 1), img, img);
+    }
+    if (flip != -100)
+        cv::flip(img, img, flip);
+    cv::Mat t;
+    switch (rot) {
+    case 1:
+        cv::transpose(img, t);
+        cv::flip(t, img, 0);
+        break;
+
+    case 2:
+        cv::flip(img, img, -1);
+        break;
+
+    case 3:
+        cv::transpose(img, t);
+        cv::flip(t, img, 1);
+        break;
+    }
+    return img;
+}
+
+bool equal(const cv::Mat& a, const cv::Mat& b) {
+    return a.size() == b.size() && a.type() == b.type()
+           && cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+}
+
+class ImageTransformTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void apply_data();
+    void apply();
+};
+
+/*
+ * The sizes are not multiples of the tile size, and large enough for
+ * several strips, so that partial tiles are transposed too.
+ */
+void ImageTransformTest::apply_data() {
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("width");
+    QTest::addColumn<int>("height");
+    const int types[] = { CV_8UC1, CV_8UC3, CV_16UC1, CV_16UC3,
+                          // Left to OpenCV.
+                          CV_8UC4, CV_16UC4 };
+    const cv::Size sizes[] = { { 1, 1 }, { 7, 3 }, { 203, 131 },
+                               { 641, 97 } };
+    for (int type : types)
+        for (auto size : sizes)
+            QTest::newRow(qPrintable(QString("type %1, %2x%3").arg(type)
+                                     .arg(size.width).arg(size.height)))
+                << type << size.width << size.height;
+}
+
+void ImageTransformTest::apply() {
+    QFETCH(int, type);
+    QFETCH(int, width);
+    QFETCH(int, height);
+    cv::Mat input(height, width, type);
+    const int levels = CV_MAT_DEPTH(type) == CV_8U ? 256 : 65536;
+    cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(levels));
+    for (bool invert : { false, true }) {
+        for (int flip : { -100, 0, 1, -1 }) {
+            for (int rot = 0; rot < 4; rot++) {
+                const QByteArray where = QString("invert %1, flip %2, rot %3")
+                                         .arg(invert).arg(flip).arg(rot)
+                                         .toLocal8Bit();
+                const ImageTransform transform(invert, flip, rot);
+                const cv::Mat expected = reference(input, invert, flip, rot);
+                cv::Mat output(transform.outputSize(input.size()), type);
+                transform.apply(input, output);
+                QVERIFY2(equal(output, expected), where.constData());
+                if (transform.isInPlace()) {
+                    cv::Mat image = input.clone();
+                    transform.apply(image, image);
+                    QVERIFY2(equal(image, expected), where.constData());
+                }
+                if (transform.isIdentity())
+                    QVERIFY2(equal(input, expected), where.constData());
+            }
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(ImageTransformTest)
+#include "imagetransform.moc"
@@ -0,0 +1,188 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filters/levels.h"
+#include <QtTest>
+
+using namespace QArv;
+
+namespace
+{
+
+// A levels filter with the given settings, which it reads from QSettings.
+ImageFilterPtr levels(double black, double white, double gamma) {
+    {
+        QSettings settings;
+        settings.setValue("qarv_filters_levels/black", black);
+        settings.setValue("qarv_filters_levels/white", white);
+        settings.setValue("qarv_filters_levels/gamma", gamma);
+    }
+    auto filter = new LevelsFilter(nullptr);
+    filter->restoreSettings();
+    filter->setEnabled(true);
+    return ImageFilterPtr(filter);
+}
+
+// Every value of the depth, so that the image spans the full scale.
+cv::Mat ramp(int depth) {
+    cv::Mat image(1, depth == CV_8U ? 256 : 65536, CV_32S);
+    for (int i = 0; i < image.cols; i++)
+        image.at<int>(i) = i;
+    image.convertTo(image, depth);
+    return image;
+}
+
+cv::Mat randomImage(int type) {
+    cv::Mat image(37, 53, type);
+    const int levels = CV_MAT_DEPTH(type) == CV_8U ? 256 : 65536;
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(levels));
+    return image;
+}
+
+// Not a point operation, and one that does not commute with levels.
+class InvertFilter : public ImageFilter {
+public:
+    InvertFilter() : ImageFilter(nullptr) { setEnabled(true); }
+
+    ImageFilterSettingsWidget* createSettingsWidget() override {
+        return nullptr;
+    }
+    void restoreSettings() override {}
+    void saveSettings() override {}
+    void filterImage(cv::Mat& image) override {
+        seen = image.clone();
+        const int max = image.depth() == CV_8U ? 255 : 65535;
+        cv::subtract(cv::Scalar::all(max), image, image);
+    }
+
+    cv::Mat seen;
+};
+
+bool equal(const cv::Mat& a, const cv::Mat& b) {
+    return a.size() == b.size() && a.type() == b.type()
+           && cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+}
+
+class LevelsTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void table_data();
+    void table();
+    void fusion_data();
+    void fusion();
+    void fusionSplit_data() { fusion_data(); }
+    void fusionSplit();
+};
+
+void LevelsTest::initTestCase() {
+    QStandardPaths::setTestModeEnabled(true);
+    QCoreApplication::setOrganizationName("QArvTest");
+    QCoreApplication::setApplicationName("levels");
+}
+
+void LevelsTest::table_data() {
+    QTest::addColumn<int>("depth");
+    QTest::addColumn<double>("black");
+    QTest::addColumn<double>("white");
+    QTest::addColumn<double>("gamma");
+    for (int depth : { CV_8U, CV_16U }) {
+        const QString bits = depth == CV_8U ? "8-bit" : "16-bit";
+        QTest::newRow(qPrintable(bits + ", identity"))
+            << depth << 0. << 1. << 1.;
+        QTest::newRow(qPrintable(bits + ", stretch"))
+            << depth << 0.1 << 0.9 << 1.;
+        QTest::newRow(qPrintable(bits + ", gamma"))
+            << depth << 0. << 1. << 2.2;
+        QTest::newRow(qPrintable(bits + ", inverse gamma"))
+            << depth << 0. << 1. << 0.45;
+        QTest::newRow(qPrintable(bits + ", all"))
+            << depth << 0.05 << 0.6 << 3.;
+    }
+}
+
+/*
+ * The lookup tables must give what the float path gives on a full-scale
+ * frame, where it takes values relative to the same maximum, up to the
+ * rounding of the float result.
+ */
+void LevelsTest::table() {
+    QFETCH(int, depth);
+    QFETCH(double, black);
+    QFETCH(double, white);
+    QFETCH(double, gamma);
+    auto filter = levels(black, white, gamma);
+    cv::Mat image = ramp(depth), reference;
+    ramp(depth).convertTo(reference, CV_32F);
+    filter->filterImage(image);
+    filter->filterImage(reference);
+    QCOMPARE(image.depth(), depth);
+    QCOMPARE(reference.depth(), CV_32F);
+    reference.convertTo(reference, depth);
+    QVERIFY(cv::norm(image, reference, cv::NORM_INF) <= 1);
+}
+
+void LevelsTest::fusion_data() {
+    QTest::addColumn<int>("type");
+    QTest::newRow("8-bit") << int(CV_8UC1);
+    QTest::newRow("8-bit color") << int(CV_8UC3);
+    QTest::newRow("16-bit") << int(CV_16UC1);
+    QTest::newRow("16-bit color") << int(CV_16UC3);
+}
+
+// Levels following each other are fused into one table, with the same result.
+void LevelsTest::fusion() {
+    QFETCH(int, type);
+    auto first = levels(0.1, 0.8, 2.2);
+    auto second = levels(0.05, 0.95, 0.7);
+    const cv::Mat input = randomImage(type);
+    cv::Mat expected = input.clone();
+    first->filterImage(expected);
+    second->filterImage(expected);
+    cv::Mat image = input.clone();
+    ImageFilter::filterChain({ first, second }, image);
+    QVERIFY(equal(image, expected));
+}
+
+// A filter that is not a point operation ends the group of fused filters.
+void LevelsTest::fusionSplit() {
+    QFETCH(int, type);
+    auto first = levels(0.1, 0.8, 2.2);
+    auto invert = new InvertFilter;
+    auto second = levels(0.05, 0.95, 0.7);
+    const cv::Mat input = randomImage(type);
+    cv::Mat afterFirst = input.clone();
+    first->filterImage(afterFirst);
+    cv::Mat expected = afterFirst.clone();
+    cv::subtract(cv::Scalar::all(type == CV_8UC1 || type == CV_8UC3 ? 255
+                                                                   : 65535),
+                 expected, expected);
+    second->filterImage(expected);
+    cv::Mat image = input.clone();
+    ImageFilter::filterChain({ first, ImageFilterPtr(invert), second },
+                             image);
+    QVERIFY(equal(invert->seen, afterFirst));
+    QVERIFY(equal(image, expected));
+}
+
+QTEST_GUILESS_MAIN(LevelsTest)
+#include "levels.moc"
@@ -0,0 +1,236 @@
+/*
+    QArv, a Qt interface to aravis.
+    Copyright (C) 2012, 2013 Jure Varlec <jure.varlec@ad-vega.si>
+                             Andrej Lajovic <andrej.lajovic@ad-vega.si>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decoders/unpackers.h"
+#include <QtTest>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace QArv;
+
+namespace
+{
+
+/*
+ * Row widths around the vector widths, so that the vectorized loops end at
+ * every possible offset and leave tail pixels to the plain code.
+ */
+const size_t widths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 15, 16, 17, 31, 32, 33,
+                          47, 63, 64, 65, 100, 127, 1001, 4099 };
+
+// Written to the output to catch kernels that write past the end.
+const uint16_t sentinel = 0xA5A5;
+
+template<typename T>
+std::vector<T> randomData(size_t count, unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> distribution(0, 65535);
+    std::vector<T> data(count);
+    for (auto& v : data)
+        v = T(distribution(generator));
+    return data;
+}
+
+/*
+ * Runs a packed unpacker and its reference on random data, with the input
+ * holding exactly the pixels and with the input running out a byte early.
+ */
+template<typename Kernel>
+void comparePacked(Kernel kernel, Kernel reference, size_t bitsPerPixel) {
+    for (size_t width : widths) {
+        const size_t bytes = (width * bitsPerPixel + 7) / 8;
+        const auto in = randomData<uint8_t>(bytes, width);
+        for (size_t inBytes : { bytes, bytes > 0 ? bytes - 1 : 0 }) {
+            std::vector<uint16_t> out(width + 8, sentinel);
+            std::vector<uint16_t> expected(width + 8, sentinel);
+            const size_t n = kernel(in.data(), inBytes, out.data(), width);
+            const size_t m = reference(in.data(), inBytes, expected.data(),
+                                       width);
+            QCOMPARE(n, m);
+            QVERIFY2(out == expected,
+                     qPrintable(QString("width %1, %2 bytes")
+                                .arg(width).arg(inBytes)));
+        }
+    }
+}
+
+}
+
+class UnpackersTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void mono12Packed_data() { instructionSets(); }
+    void mono12Packed();
+    void mono10p_data() { instructionSets(); }
+    void mono10p();
+    void mono12p_data() { instructionSets(); }
+    void mono12p();
+    void shiftMono16_data() { instructionSets(); }
+    void shiftMono16();
+    void offsetMono8Signed_data() { instructionSets(); }
+    void offsetMono8Signed();
+    void expandYuv411_data() { instructionSets(); }
+    void expandYuv411();
+    void correctFlatField_data() { instructionSets(); }
+    void correctFlatField();
+    void correctFlatFieldSaturation_data() { instructionSets(); }
+    void correctFlatFieldSaturation();
+
+private:
+    void instructionSets();
+    QByteArray supported;
+};
+
+// Each test runs once for every instruction set the dispatcher knows.
+void UnpackersTest::instructionSets() {
+    QTest::addColumn<QByteArray>("instructionSet");
+    for (const char* name : { "none", "SSE2", "SSSE3", "AVX2" })
+        QTest::newRow(name) << QByteArray(name);
+}
+
+void UnpackersTest::initTestCase() {
+    supported = unpackerInstructionSet();
+}
+
+void UnpackersTest::init() {
+    if (!setUnpackerInstructionSet(QTest::currentDataTag()))
+        QSKIP("Not supported by the CPU.");
+}
+
+void UnpackersTest::cleanup() {
+    setUnpackerInstructionSet(supported.constData());
+}
+
+void UnpackersTest::mono12Packed() {
+    comparePacked(&QArv::unpackMono12Packed, &unpackMono12PackedScalar, 12);
+}
+
+void UnpackersTest::mono10p() {
+    comparePacked(&QArv::unpackMono10p, &unpackMono10pScalar, 10);
+}
+
+void UnpackersTest::mono12p() {
+    comparePacked(&QArv::unpackMono12p, &unpackMono12pScalar, 12);
+}
+
+void UnpackersTest::shiftMono16() {
+    for (size_t width : widths) {
+        const auto in = randomData<uint16_t>(width, width);
+        for (unsigned shift : { 0, 2, 4, 6, 8 }) {
+            std::vector<uint16_t> out(width + 8, sentinel);
+            std::vector<uint16_t> expected(width + 8, sentinel);
+            QArv::shiftMono16(in.data(), out.data(), width, shift);
+            shiftMono16Scalar(in.data(), expected.data(), width, shift);
+            QVERIFY2(out == expected,
+                     qPrintable(QString("width %1, shift %2")
+                                .arg(width).arg(shift)));
+        }
+    }
+}
+
+void UnpackersTest::offsetMono8Signed() {
+    for (size_t width : widths) {
+        const auto in = randomData<int8_t>(width, width);
+        std::vector<uint8_t> out(width + 8, uint8_t(sentinel));
+        std::vector<uint8_t> expected(width + 8, uint8_t(sentinel));
+        QArv::offsetMono8Signed(in.data(), out.data(), width);
+        offsetMono8SignedScalar(in.data(), expected.data(), width);
+        QVERIFY2(out == expected, qPrintable(QString("width %1").arg(width)));
+    }
+}
+
+void UnpackersTest::expandYuv411() {
+    for (size_t width : widths) {
+        const size_t bytes = (width + 3) / 4 * 6;
+        const auto in = randomData<uint8_t>(bytes, width);
+        for (size_t inBytes : { bytes, bytes > 0 ? bytes - 1 : 0 }) {
+            std::vector<uint8_t> out(2 * width + 16, uint8_t(sentinel));
+            std::vector<uint8_t> expected(2 * width + 16, uint8_t(sentinel));
+            const size_t n = QArv::expandYuv411(in.data(), inBytes,
+                                                out.data(), width);
+            const size_t m = expandYuv411Scalar(in.data(), inBytes,
+                                                expected.data(), width);
+            QCOMPARE(n, m);
+            QVERIFY2(out == expected,
+                     qPrintable(QString("width %1, %2 bytes")
+                                .arg(width).arg(inBytes)));
+        }
+    }
+}
+
+void UnpackersTest::correctFlatField() {
+    for (size_t width : widths) {
+        const auto pixels = randomData<uint16_t>(width, width);
+        const auto dark = randomData<uint16_t>(width, width + 1);
+        auto gain = randomData<uint16_t>(width, width + 2);
+        // Mostly gains around 1, as in real calibrations.
+        for (size_t i = 0; i < width; i += 2)
+            gain[i] = (1 << 14) - 2048 + gain[i] % 4096;
+        std::vector<uint16_t> out(pixels), expected(pixels);
+        out.resize(width + 8, sentinel);
+        expected.resize(width + 8, sentinel);
+        QArv::correctFlatField(out.data(), dark.data(), gain.data(), width);
+        correctFlatFieldScalar(expected.data(), dark.data(), gain.data(),
+                               width);
+        QVERIFY2(out == expected, qPrintable(QString("width %1").arg(width)));
+    }
+}
+
+/*
+ * The extremes: dark above the pixel saturates at zero, and the largest
+ * gains overflow the 16 bits of the result.
+ */
+void UnpackersTest::correctFlatFieldSaturation() {
+    const uint16_t values[] = { 0, 1, 0x7FFF, 0x8000, 0xFFFE, 0xFFFF };
+    const uint16_t gains[] = { 0, 1, 1 << 14, (1 << 14) + 1, 0x7FFF, 0x8000,
+                               0xFFFF };
+    std::vector<uint16_t> pixels, dark, gain;
+    for (uint16_t p : values)
+        for (uint16_t d : values)
+            for (uint16_t g : gains) {
+                pixels.push_back(p);
+                dark.push_back(d);
+                gain.push_back(g);
+            }
+    for (size_t width : widths) {
+        width = std::min(width, pixels.size());
+        std::vector<uint16_t> out(pixels), expected(pixels);
+        QArv::correctFlatField(out.data(), dark.data(), gain.data(), width);
+        correctFlatFieldScalar(expected.data(), dark.data(), gain.data(),
+                               width);
+        QVERIFY2(out == expected, qPrintable(QString("width %1").arg(width)));
+    }
+    // The reference itself.
+    uint16_t p[] = { 100, 0xFFFF, 0xFFFF };
+    const uint16_t d[] = { 200, 0, 0 };
+    const uint16_t g[] = { 0xFFFF, 0xFFFF, 1 << 14 };
+    correctFlatFieldScalar(p, d, g, 3);
+    QCOMPARE(p[0], uint16_t(0));
+    QCOMPARE(p[1], uint16_t(0xFFFF));
+    QCOMPARE(p[2], uint16_t(0xFFFF));
+}
+
+QTEST_GUILESS_MAIN(UnpackersTest)
+#include "unpackers.moc"